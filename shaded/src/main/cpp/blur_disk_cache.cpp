@@ -0,0 +1,283 @@
+#include "blur_disk_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+    constexpr uint32_t kMagic = 0x524C4253; // "SBLR"
+    constexpr uint32_t kVersion = 1;
+    constexpr const char* kExtension = ".blur";
+
+    // Padded to 64 bytes so the pixel rows that follow are cache line aligned in the mapping
+    struct CacheFileHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t width;
+        uint32_t height;
+        uint64_t pixelBytes;
+        uint8_t reserved[32];
+    };
+    static_assert(sizeof(CacheFileHeader) == 64, "Cache header must stay 64 bytes");
+
+    inline uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    bool writeFully(int fd, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<size_t>(written);
+        }
+        return true;
+    }
+
+    bool hasCacheExtension(const char* name) {
+        size_t length = std::strlen(name);
+        size_t extensionLength = std::strlen(kExtension);
+        return length > extensionLength &&
+               std::strcmp(name + length - extensionLength, kExtension) == 0;
+    }
+}
+
+BlurDiskCache::Entry::Entry(void* mapping, size_t mappingSize, int width, int height,
+                            const unsigned char* pixels)
+        : mapping_(mapping), mappingSize_(mappingSize), width_(width), height_(height), pixels_(pixels) {}
+
+BlurDiskCache::Entry::~Entry() {
+    munmap(mapping_, mappingSize_);
+}
+
+void BlurDiskCache::Entry::copyPixels(unsigned char* target, int stride) const {
+    size_t rowBytes = static_cast<size_t>(width_) * 4;
+    if (static_cast<size_t>(stride) == rowBytes) {
+        std::memcpy(target, pixels_, pixelBytes());
+        return;
+    }
+    for (int y = 0; y < height_; ++y) {
+        std::memcpy(target + static_cast<size_t>(y) * stride, pixels_ + y * rowBytes, rowBytes);
+    }
+}
+
+BlurDiskCache::BlurDiskCache(const std::string& directory, size_t maxBytes)
+        : directory_(directory), maxBytes_(maxBytes), totalBytes_(0) {
+    mkdir(directory_.c_str(), 0700);
+    totalBytes_ = scanDirectorySize();
+}
+
+uint64_t BlurDiskCache::hashPixels(const unsigned char* pixels, int width, int height, int stride) {
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    uint64_t hash = 0x9e3779b97f4a7c15ULL ^ (rowBytes * height);
+
+    size_t wordCount = rowBytes / sizeof(uint64_t);
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = pixels + static_cast<size_t>(y) * stride;
+        for (size_t i = 0; i < wordCount; ++i) {
+            uint64_t word;
+            std::memcpy(&word, row + i * sizeof(uint64_t), sizeof(word));
+            hash = (hash ^ word) * 0x100000001b3ULL;
+            hash = (hash << 31) | (hash >> 33);
+        }
+
+        for (size_t i = wordCount * sizeof(uint64_t); i < rowBytes; ++i) {
+            hash = (hash ^ row[i]) * 0x100000001b3ULL;
+        }
+    }
+
+    return mix(hash);
+}
+
+uint64_t BlurDiskCache::makeKey(uint64_t sourceHash, int width, int height, float radius,
+                                BlurEdgeMode edgeMode) {
+    uint32_t radiusBits;
+    std::memcpy(&radiusBits, &radius, sizeof(radiusBits));
+
+    uint64_t key = mix(sourceHash);
+    key = mix(key ^ ((static_cast<uint64_t>(width) << 32) | static_cast<uint32_t>(height)));
+    key = mix(key ^ ((static_cast<uint64_t>(radiusBits) << 8) | static_cast<uint64_t>(edgeMode)));
+    return key;
+}
+
+std::string BlurDiskCache::pathForKey(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016" PRIx64 "%s", key, kExtension);
+    return directory_ + name;
+}
+
+std::unique_ptr<BlurDiskCache::Entry> BlurDiskCache::lookup(uint64_t key) {
+    int fd = open(pathForKey(key).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return nullptr;
+
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) < 0 || static_cast<size_t>(fileStat.st_size) < sizeof(CacheFileHeader)) {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t mappingSize = static_cast<size_t>(fileStat.st_size);
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    // Bump the modification time, eviction drops the least recently used entries first
+    futimens(fd, nullptr);
+    close(fd);
+
+    if (mapping == MAP_FAILED) return nullptr;
+
+    const CacheFileHeader* header = static_cast<const CacheFileHeader*>(mapping);
+    size_t expectedBytes = static_cast<size_t>(header->width) * header->height * 4;
+    if (header->magic != kMagic || header->version != kVersion || header->key != key ||
+        header->pixelBytes != expectedBytes ||
+        mappingSize < sizeof(CacheFileHeader) + expectedBytes) {
+        munmap(mapping, mappingSize);
+        return nullptr;
+    }
+
+    madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+
+    const unsigned char* pixels = static_cast<const unsigned char*>(mapping) + sizeof(CacheFileHeader);
+    return std::make_unique<Entry>(mapping, mappingSize, static_cast<int>(header->width),
+                                   static_cast<int>(header->height), pixels);
+}
+
+void BlurDiskCache::store(uint64_t key, int width, int height, const unsigned char* pixels, int stride) {
+    static std::atomic<unsigned int> temporaryCounter(0);
+
+    CacheFileHeader header{};
+    header.magic = kMagic;
+    header.version = kVersion;
+    header.key = key;
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    header.pixelBytes = static_cast<uint64_t>(width) * height * 4;
+
+    size_t fileBytes = sizeof(header) + header.pixelBytes;
+    if (fileBytes > maxBytes_) return;
+
+    std::string path = pathForKey(key);
+    std::string temporaryPath = path + ".tmp" + std::to_string(getpid()) + "_" +
+                                std::to_string(temporaryCounter.fetch_add(1));
+
+    int fd = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) return;
+
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    bool written = writeFully(fd, &header, sizeof(header));
+    if (static_cast<size_t>(stride) == rowBytes) {
+        written = written && writeFully(fd, pixels, header.pixelBytes);
+    } else {
+        for (int y = 0; y < height && written; ++y) {
+            written = writeFully(fd, pixels + static_cast<size_t>(y) * stride, rowBytes);
+        }
+    }
+    close(fd);
+
+    if (!written) {
+        unlink(temporaryPath.c_str());
+        return;
+    }
+
+    {
+        // Under the lock, so two stores of the same key can't both count the file they replace
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        struct stat replaced{};
+        size_t replacedBytes = stat(path.c_str(), &replaced) == 0 ? static_cast<size_t>(replaced.st_size) : 0;
+
+        if (rename(temporaryPath.c_str(), path.c_str()) < 0) {
+            unlink(temporaryPath.c_str());
+            return;
+        }
+
+        totalBytes_ = totalBytes_ - std::min(totalBytes_, replacedBytes) + fileBytes;
+    }
+    evictIfNeeded();
+}
+
+size_t BlurDiskCache::totalBytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return totalBytes_;
+}
+
+size_t BlurDiskCache::scanDirectorySize() {
+    size_t total = 0;
+
+    DIR* directory = opendir(directory_.c_str());
+    if (!directory) return 0;
+
+    while (dirent* entry = readdir(directory)) {
+        if (!hasCacheExtension(entry->d_name)) continue;
+
+        struct stat fileStat{};
+        std::string path = directory_ + "/" + entry->d_name;
+        if (stat(path.c_str(), &fileStat) == 0) {
+            total += static_cast<size_t>(fileStat.st_size);
+        }
+    }
+    closedir(directory);
+
+    return total;
+}
+
+void BlurDiskCache::evictIfNeeded() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (totalBytes_ <= maxBytes_) return;
+
+    struct CachedFile {
+        std::string path;
+        size_t size;
+        timespec modified;
+    };
+    std::vector<CachedFile> files;
+    size_t total = 0;
+
+    DIR* directory = opendir(directory_.c_str());
+    if (!directory) return;
+
+    while (dirent* entry = readdir(directory)) {
+        if (!hasCacheExtension(entry->d_name)) continue;
+
+        struct stat fileStat{};
+        std::string path = directory_ + "/" + entry->d_name;
+        if (stat(path.c_str(), &fileStat) == 0) {
+            files.push_back({path, static_cast<size_t>(fileStat.st_size), fileStat.st_mtim});
+            total += static_cast<size_t>(fileStat.st_size);
+        }
+    }
+    closedir(directory);
+
+    std::sort(files.begin(), files.end(), [](const CachedFile& a, const CachedFile& b) {
+        if (a.modified.tv_sec != b.modified.tv_sec) return a.modified.tv_sec < b.modified.tv_sec;
+        return a.modified.tv_nsec < b.modified.tv_nsec;
+    });
+
+    // Evict down to 3/4 of the budget so a full cache doesn't rescan the directory on every store
+    size_t target = maxBytes_ / 4 * 3;
+    for (const CachedFile& file : files) {
+        if (total <= target) break;
+        if (unlink(file.path.c_str()) == 0) {
+            total -= file.size;
+        }
+    }
+
+    totalBytes_ = total;
+}
@@ -0,0 +1,70 @@
+#ifndef BLUR_DISK_CACHE_H
+#define BLUR_DISK_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "blur_edge_mode.h"
+
+// Persistent cache of blurred results. Every entry is one file holding a small header followed
+// by the raw, tightly packed RGBA8888 rows, so a hit is mmap'd and copied (or uploaded) as is.
+//
+// Entries are written to a temporary file and renamed into place, so concurrent readers only
+// ever see complete files, and mappings stay valid even if the entry gets evicted meanwhile.
+class BlurDiskCache {
+public:
+    // A mapped cache entry, unmapped when destroyed
+    class Entry {
+    public:
+        Entry(void* mapping, size_t mappingSize, int width, int height, const unsigned char* pixels);
+        ~Entry();
+
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        int width() const { return width_; }
+        int height() const { return height_; }
+        const unsigned char* pixels() const { return pixels_; }
+        size_t pixelBytes() const { return static_cast<size_t>(width_) * height_ * 4; }
+        // Copies the pixels into rows stride bytes apart
+        void copyPixels(unsigned char* target, int stride) const;
+
+    private:
+        void* mapping_;
+        size_t mappingSize_;
+        int width_;
+        int height_;
+        const unsigned char* pixels_;
+    };
+
+    BlurDiskCache(const std::string& directory, size_t maxBytes);
+    ~BlurDiskCache() = default;
+
+    // Hash of RGBA8888 pixels in rows stride bytes apart. Only the width * 4 bytes of each row
+    // count, so the same image hashes the same whatever padding its rows have.
+    static uint64_t hashPixels(const unsigned char* pixels, int width, int height, int stride);
+    static uint64_t makeKey(uint64_t sourceHash, int width, int height, float radius, BlurEdgeMode edgeMode);
+
+    // Returns nullptr on a miss or if the entry is unreadable
+    std::unique_ptr<Entry> lookup(uint64_t key);
+    // stride is the row size in bytes of pixels, entries are stored tightly packed either way
+    void store(uint64_t key, int width, int height, const unsigned char* pixels, int stride);
+
+    // Bytes of entries the cache counts towards maxBytes
+    size_t totalBytes() const;
+
+private:
+    std::string pathForKey(uint64_t key) const;
+    size_t scanDirectorySize();
+    void evictIfNeeded();
+
+    std::string directory_;
+    size_t maxBytes_;
+
+    mutable std::mutex mutex_;
+    size_t totalBytes_;
+};
+
+#endif // BLUR_DISK_CACHE_H
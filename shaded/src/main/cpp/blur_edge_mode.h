@@ -0,0 +1,10 @@
+#ifndef BLUR_EDGE_MODE_H
+#define BLUR_EDGE_MODE_H
+
+// Mirrors io.sifr.shaded.blurProcessor.BlurEdgeTreatment
+enum class BlurEdgeMode : int {
+    Rectangle = 0,
+    Unbounded = 1
+};
+
+#endif // BLUR_EDGE_MODE_H
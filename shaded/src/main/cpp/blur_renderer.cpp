@@ -1,11 +1,22 @@
 #include "blur_renderer.h"
+#include "readback_scale.h"
+#include "small_kernel.h"
+#include <algorithm>
+#include <cmath>
 
 BlurRenderer::BlurRenderer(int width, int height)
-        : eglHelper_(width, height),
-          quadVBO_(0), horizontalShaderProgram_(0), verticalShaderProgram_(0),
+        : quadVBO_(0), horizontalShaderProgram_(0), verticalShaderProgram_(0), copyShaderProgram_(0),
+          singlePassShaderProgram_(0),
           attrPos_(-1), attrTexCoord_(-1),
-          uniformTexture_(-1), uniformRadius_(-1), uniformTextureSize_(-1), uniformDirection_(-1),
-          framebuffer1_(0), framebuffer2_(0), fboTexture1_(0), fboTexture2_(0), initialized_(false) {}
+          horizontalUniforms_(), verticalUniforms_(), copyUniforms_(), singlePassUniforms_(),
+          eglHelper_(width, height),
+          framebuffer1_(0), framebuffer2_(0), framebuffer3_(0),
+          fboTexture1_(0), fboTexture2_(0), fboTexture3_(0),
+          outputFramebuffer_(0), outputTexture_(0),
+          previousFrameKey_(0), previousRadius_(0.0f), hasPreviousFrame_(false),
+          currentWidth_(0), currentHeight_(0), outputWidth_(0), outputHeight_(0),
+          intermediateWidth_(0), intermediateHeight_(0), framebufferAllocations_(0),
+          initialized_(false) {}
 
 void BlurRenderer::initialize() {
     if (initialized_) return;
@@ -19,7 +30,8 @@ void BlurRenderer::initialize() {
     initialized_ = true;
 }
 
-GLuint BlurRenderer::uploadBitmapAsTexture(unsigned char* pixels, int width, int height) {
+GLuint BlurRenderer::uploadBitmapAsTexture(const unsigned char* pixels, int width, int height,
+                                        PixelFormat format, int stride) {
     initialize();
     eglHelper_.makeCurrent();
 
@@ -27,8 +39,7 @@ GLuint BlurRenderer::uploadBitmapAsTexture(unsigned char* pixels, int width, int
     glGenTextures(1, &textureId);
     glBindTexture(GL_TEXTURE_2D, textureId);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    uploadPixels(pixels, width, height, format, stride);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -38,18 +49,30 @@ GLuint BlurRenderer::uploadBitmapAsTexture(unsigned char* pixels, int width, int
     return textureId;
 }
 
-void BlurRenderer::render(GLuint textureId, int width, int height, float radius) {
+void BlurRenderer::render(GLuint textureId, int width, int height, float radius, int downscale) {
     initialize();
     eglHelper_.makeCurrent();
 
+    hasPreviousFrame_ = false;
+
     if (radius <= 0.5f) {
         // No blur needed, just render directly
+        resizeFramebuffers(width, height, width, height);
         renderDirect(textureId, width, height);
         return;
     }
 
     // Resize framebuffer textures if needed
-    resizeFramebuffers(width, height);
+    resizeFramebuffers(width, height,
+                       calculateDownscaledSize(width, downscale),
+                       calculateDownscaledSize(height, downscale));
+
+    if (radius <= kSinglePassMaxRadius) {
+        renderSinglePass(textureId, width, height, radius);
+        return;
+    }
+
+    resizeIntermediate(outputWidth_, height);
 
     // First pass: Horizontal blur
     renderHorizontalPass(textureId, width, height, radius);
@@ -58,80 +81,170 @@ void BlurRenderer::render(GLuint textureId, int width, int height, float radius)
     renderVerticalPass(width, height, radius);
 }
 
+void BlurRenderer::renderInto(GLuint textureId, int width, int height, float radius, int downscale,
+                              GLuint framebuffer) {
+    initialize();
+
+    // Every final pass draws into outputFramebuffer_, so pointing it elsewhere is all it takes
+    GLuint outputFramebuffer = outputFramebuffer_;
+    outputFramebuffer_ = framebuffer;
+    render(textureId, width, height, radius, downscale);
+    outputFramebuffer_ = outputFramebuffer;
+}
+
+void BlurRenderer::renderScrolled(GLuint textureId, int width, int height, float radius,
+                                  long long frameKey, int scrollX, int scrollY) {
+    bool reusable = hasPreviousFrame_ && previousFrameKey_ == frameKey && previousRadius_ == radius &&
+                    outputWidth_ == width && outputHeight_ == height;
+
+    // Pixels whose whole kernel footprint lies inside both the previous and the new frame come out
+    // the same as last time, everything else is blurred again
+    int kernelRadius = static_cast<int>(std::ceil(radius));
+    int keepX0 = std::max(0, -scrollX) + kernelRadius;
+    int keepX1 = std::min(width, width - scrollX) - kernelRadius;
+    int keepY0 = std::max(0, -scrollY) + kernelRadius;
+    int keepY1 = std::min(height, height - scrollY) - kernelRadius;
+
+    if (!reusable || keepX0 >= keepX1 || keepY0 >= keepY1) {
+        // Reuse needs output pixels that map 1:1 to input pixels, so never downscale here
+        render(textureId, width, height, radius, 1);
+
+        previousFrameKey_ = frameKey;
+        previousRadius_ = radius;
+        hasPreviousFrame_ = radius > 0.5f;
+        return;
+    }
+
+    eglHelper_.makeCurrent();
+
+    // Ping-pong between the two output framebuffers, the previous output is the shift source
+    GLuint previousTexture = outputTexture_;
+    if (outputFramebuffer_ == framebuffer2_) {
+        outputFramebuffer_ = framebuffer3_;
+        outputTexture_ = fboTexture3_;
+    } else {
+        outputFramebuffer_ = framebuffer2_;
+        outputTexture_ = fboTexture2_;
+    }
+
+    renderShiftedCopy(previousTexture, width, height, scrollX, scrollY);
+
+    // Top and bottom strips over the full width, left and right strips in between
+    glEnable(GL_SCISSOR_TEST);
+    renderRegion(textureId, width, height, radius, 0, 0, width, keepY0);
+    renderRegion(textureId, width, height, radius, 0, keepY1, width, height);
+    renderRegion(textureId, width, height, radius, 0, keepY0, keepX0, keepY1);
+    renderRegion(textureId, width, height, radius, keepX1, keepY0, width, keepY1);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+void BlurRenderer::renderShiftedCopy(GLuint sourceTexture, int width, int height, int offsetX, int offsetY) {
+    glUseProgram(copyShaderProgram_);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer_);
+    glViewport(0, 0, width, height);
+
+    glUniform2f(copyUniforms_.offset,
+                static_cast<float>(offsetX) / static_cast<float>(width),
+                static_cast<float>(offsetY) / static_cast<float>(height));
+
+    glBindTexture(GL_TEXTURE_2D, sourceTexture);
+
+    drawQuad();
+}
+
+// Expects the scissor test to be enabled
+void BlurRenderer::renderRegion(GLuint textureId, int width, int height, float radius,
+                                int x0, int y0, int x1, int y1) {
+    if (x0 >= x1 || y0 >= y1) return;
+
+    // The vertical pass over the region reads the horizontal pass one kernel radius above and below it
+    int kernelRadius = static_cast<int>(std::ceil(radius));
+    int intermediateY0 = std::max(0, y0 - kernelRadius);
+    int intermediateY1 = std::min(height, y1 + kernelRadius);
+
+    if (radius <= kSinglePassMaxRadius) {
+        glScissor(x0, y0, x1 - x0, y1 - y0);
+        renderSinglePass(textureId, width, height, radius);
+        return;
+    }
+
+    resizeIntermediate(outputWidth_, height);
+
+    glScissor(x0, intermediateY0, x1 - x0, intermediateY1 - intermediateY0);
+    renderHorizontalPass(textureId, width, height, radius);
+
+    glScissor(x0, y0, x1 - x0, y1 - y0);
+    renderVerticalPass(width, height, radius);
+}
+
 void BlurRenderer::renderHorizontalPass(GLuint textureId, int width, int height, float radius) {
     glUseProgram(horizontalShaderProgram_);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1_);
-    glViewport(0, 0, width, height);
+    glViewport(0, 0, outputWidth_, height);
 
     // Set uniforms
-    glUniform1f(glGetUniformLocation(horizontalShaderProgram_, "uRadius"), radius);
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uTextureSize"),
+    glUniform1f(horizontalUniforms_.radius, radius);
+    glUniform2f(horizontalUniforms_.textureSize,
                 static_cast<float>(width), static_cast<float>(height));
 
     // Bind input texture
-    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureId);
-    glUniform1i(glGetUniformLocation(horizontalShaderProgram_, "uTexture"), 0);
-
-    drawQuad(horizontalShaderProgram_);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    drawQuad();
 }
 
 void BlurRenderer::renderVerticalPass(int width, int height, float radius) {
     glUseProgram(verticalShaderProgram_);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
-    glViewport(0, 0, width, height);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer_);
+    glViewport(0, 0, outputWidth_, outputHeight_);
 
     // Set uniforms
-    glUniform1f(glGetUniformLocation(verticalShaderProgram_, "uRadius"), radius);
-    glUniform2f(glGetUniformLocation(verticalShaderProgram_, "uTextureSize"),
+    glUniform1f(verticalUniforms_.radius, radius);
+    glUniform2f(verticalUniforms_.textureSize,
                 static_cast<float>(width), static_cast<float>(height));
 
     // Bind intermediate texture from horizontal pass
-    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, fboTexture1_);
-    glUniform1i(glGetUniformLocation(verticalShaderProgram_, "uTexture"), 0);
 
-    drawQuad(verticalShaderProgram_);
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    drawQuad();
 }
 
 void BlurRenderer::renderDirect(GLuint textureId, int width, int height) {
-    // Simple pass-through for no blur
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
-    glViewport(0, 0, width, height);
-
-    // Clear and copy texture directly
-    glClear(GL_COLOR_BUFFER_BIT);
-    // You could implement a simple copy shader here, or just use the vertical shader with radius 0
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    // Pass-through for no blur, a copy shifted by nothing
+    renderShiftedCopy(textureId, width, height, 0, 0);
 }
 
-void BlurRenderer::drawQuad(GLuint shaderProgram) {
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
+void BlurRenderer::renderSinglePass(GLuint textureId, int width, int height, float radius) {
+    // Taps 1 and 2 on each side fold into one bilinear fetch between them, so the 5x5 kernel
+    // takes 3x3 fetches. Clamp to edge sampling of the source keeps the rectangle edge clamping.
+    float weights[3];
+    calculateSmallKernelWeights(radius, weights);
+    float sideWeight = weights[1] + weights[2];
+    // Below radius 1 the kernel is the center tap alone, the side fetches then weigh nothing
+    float sideOffset = sideWeight > 0.0f ? (weights[1] + 2.0f * weights[2]) / sideWeight : 0.0f;
 
-    GLint posLoc = glGetAttribLocation(shaderProgram, "aPosition");
-    GLint texLoc = glGetAttribLocation(shaderProgram, "aTexCoord");
+    glUseProgram(singlePassShaderProgram_);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer_);
+    glViewport(0, 0, outputWidth_, outputHeight_);
 
-    glEnableVertexAttribArray(posLoc);
-    glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glUniform3f(singlePassUniforms_.kernel, weights[0], sideWeight, sideOffset);
+    glUniform2f(singlePassUniforms_.texelSize,
+                1.0f / static_cast<float>(width), 1.0f / static_cast<float>(height));
 
-    glEnableVertexAttribArray(texLoc);
-    glVertexAttribPointer(texLoc, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+    glBindTexture(GL_TEXTURE_2D, textureId);
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    drawQuad();
+}
 
-    glDisableVertexAttribArray(posLoc);
-    glDisableVertexAttribArray(texLoc);
+void BlurRenderer::drawQuad() {
+    // Vertex attributes are specified once in setupFullscreenQuad and stay enabled
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 }
 
-void BlurRenderer::readFBO(unsigned char* pixels, int width, int height) {
+void BlurRenderer::readFBO(unsigned char* pixels, int width, int height, PixelFormat format, int stride) {
     eglHelper_.makeCurrent();
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_); // Read from final output
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, outputFramebuffer_); // Read from final output
+    readPixels(pixels, width, height, format, stride);
 }
 
 void BlurRenderer::setupFullscreenQuad() {
@@ -145,48 +258,88 @@ void BlurRenderer::setupFullscreenQuad() {
     glGenBuffers(1, &quadVBO_);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Every program binds the same attribute locations, so the quad stays set up for all of them
+    glEnableVertexAttribArray(attrPos_);
+    glVertexAttribPointer(attrPos_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(attrTexCoord_);
+    glVertexAttribPointer(attrTexCoord_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 }
 
 void BlurRenderer::setupFramebuffers() {
     // Create two framebuffers for ping-pong rendering
     glGenFramebuffers(1, &framebuffer1_);
     glGenFramebuffers(1, &framebuffer2_);
+    glGenFramebuffers(1, &framebuffer3_);
 
     glGenTextures(1, &fboTexture1_);
     glGenTextures(1, &fboTexture2_);
+    glGenTextures(1, &fboTexture3_);
+
+    outputFramebuffer_ = framebuffer2_;
+    outputTexture_ = fboTexture2_;
 
     currentWidth_ = 0;
     currentHeight_ = 0;
+    outputWidth_ = 0;
+    outputHeight_ = 0;
 }
 
-void BlurRenderer::resizeFramebuffers(int width, int height) {
-    if (currentWidth_ == width && currentHeight_ == height) {
+void BlurRenderer::resizeFramebuffers(int width, int height, int outputWidth, int outputHeight) {
+    if (currentWidth_ == width && currentHeight_ == height &&
+        outputWidth_ == outputWidth && outputHeight_ == outputHeight) {
         return; // No resize needed
     }
 
+    ++framebufferAllocations_;
     currentWidth_ = width;
     currentHeight_ = height;
+    outputWidth_ = outputWidth;
+    outputHeight_ = outputHeight;
+    hasPreviousFrame_ = false;
 
-    // Setup first framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1_);
-    glBindTexture(GL_TEXTURE_2D, fboTexture1_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    // Setup second framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
+    glBindTexture(GL_TEXTURE_2D, fboTexture2_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, outputWidth, outputHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture1_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture2_, 0);
 
-    // Setup second framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
-    glBindTexture(GL_TEXTURE_2D, fboTexture2_);
+    // Setup third framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer3_);
+    glBindTexture(GL_TEXTURE_2D, fboTexture3_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, outputWidth, outputHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture3_, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void BlurRenderer::resizeIntermediate(int width, int height) {
+    if (intermediateWidth_ == width && intermediateHeight_ == height) {
+        return;
+    }
+
+    ++framebufferAllocations_;
+    intermediateWidth_ = width;
+    intermediateHeight_ = height;
+
+    // Only the two-pass blur needs the first framebuffer, single pass and copies never allocate it.
+    // The horizontal pass already renders at the output width.
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1_);
+    glBindTexture(GL_TEXTURE_2D, fboTexture1_);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture2_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture1_, 0);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -210,7 +363,35 @@ GLuint BlurRenderer::compileShader(GLenum type, const char* source) {
     return shader;
 }
 
+GLuint BlurRenderer::linkProgram(GLuint vertexShader, GLuint fragmentShader) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glBindAttribLocation(program, attrPos_, "aPosition");
+    glBindAttribLocation(program, attrTexCoord_, "aTexCoord");
+    glLinkProgram(program);
+
+    // The sampled texture is always bound to unit 0
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+
+    return program;
+}
+
+BlurRenderer::ProgramUniforms BlurRenderer::lookupUniforms(GLuint program) {
+    ProgramUniforms uniforms;
+    uniforms.radius = glGetUniformLocation(program, "uRadius");
+    uniforms.textureSize = glGetUniformLocation(program, "uTextureSize");
+    uniforms.offset = glGetUniformLocation(program, "uOffset");
+    uniforms.kernel = glGetUniformLocation(program, "uKernel");
+    uniforms.texelSize = glGetUniformLocation(program, "uTexelSize");
+    return uniforms;
+}
+
 void BlurRenderer::compileShaders() {
+    attrPos_ = 0;
+    attrTexCoord_ = 1;
+
     const char* vertexShaderSrc = R"(
         attribute vec2 aPosition;
         attribute vec2 aTexCoord;
@@ -223,7 +404,11 @@ void BlurRenderer::compileShaders() {
 
     // Optimized horizontal blur fragment shader
     const char* horizontalFragmentShaderSrc = R"(
+        #ifdef GL_FRAGMENT_PRECISION_HIGH
+        precision highp float;
+        #else
         precision mediump float;
+        #endif
         varying vec2 vTexCoord;
         uniform sampler2D uTexture;
         uniform float uRadius;
@@ -262,7 +447,11 @@ void BlurRenderer::compileShaders() {
 
     // Optimized vertical blur fragment shader
     const char* verticalFragmentShaderSrc = R"(
+        #ifdef GL_FRAGMENT_PRECISION_HIGH
+        precision highp float;
+        #else
         precision mediump float;
+        #endif
         varying vec2 vTexCoord;
         uniform sampler2D uTexture;
         uniform float uRadius;
@@ -299,6 +488,49 @@ void BlurRenderer::compileShaders() {
         }
     )";
 
+    // Shifted copy of the previous output for scrolling content
+    const char* copyFragmentShaderSrc = R"(
+        #ifdef GL_FRAGMENT_PRECISION_HIGH
+        precision highp float;
+        #else
+        precision mediump float;
+        #endif
+        varying vec2 vTexCoord;
+        uniform sampler2D uTexture;
+        uniform vec2 uOffset;
+
+        void main() {
+            gl_FragColor = texture2D(uTexture, vTexCoord + uOffset);
+        }
+    )";
+
+    // 5x5 kernel for small radii, sampled as 3x3 bilinear fetches
+    const char* singlePassFragmentShaderSrc = R"(
+        #ifdef GL_FRAGMENT_PRECISION_HIGH
+        precision highp float;
+        #else
+        precision mediump float;
+        #endif
+        varying vec2 vTexCoord;
+        uniform sampler2D uTexture;
+        uniform vec2 uTexelSize;
+        // x: center weight, y: weight of the folded taps on each side, z: their offset in texels
+        uniform vec3 uKernel;
+
+        vec4 sampleRow(float y) {
+            float x = uKernel.z * uTexelSize.x;
+            return (texture2D(uTexture, vTexCoord + vec2(-x, y)) +
+                    texture2D(uTexture, vTexCoord + vec2(x, y))) * uKernel.y +
+                   texture2D(uTexture, vTexCoord + vec2(0.0, y)) * uKernel.x;
+        }
+
+        void main() {
+            float offsetY = uKernel.z * uTexelSize.y;
+            gl_FragColor = (sampleRow(-offsetY) + sampleRow(offsetY)) * uKernel.y +
+                           sampleRow(0.0) * uKernel.x;
+        }
+    )";
+
     // Compile vertex shader (shared)
     GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSrc);
 
@@ -309,19 +541,29 @@ void BlurRenderer::compileShaders() {
     GLuint verticalFragmentShader = compileShader(GL_FRAGMENT_SHADER, verticalFragmentShaderSrc);
 
     // Create horizontal blur program
-    horizontalShaderProgram_ = glCreateProgram();
-    glAttachShader(horizontalShaderProgram_, vertexShader);
-    glAttachShader(horizontalShaderProgram_, horizontalFragmentShader);
-    glLinkProgram(horizontalShaderProgram_);
+    horizontalShaderProgram_ = linkProgram(vertexShader, horizontalFragmentShader);
 
     // Create vertical blur program
-    verticalShaderProgram_ = glCreateProgram();
-    glAttachShader(verticalShaderProgram_, vertexShader);
-    glAttachShader(verticalShaderProgram_, verticalFragmentShader);
-    glLinkProgram(verticalShaderProgram_);
+    verticalShaderProgram_ = linkProgram(vertexShader, verticalFragmentShader);
+
+    // Create copy program
+    GLuint copyFragmentShader = compileShader(GL_FRAGMENT_SHADER, copyFragmentShaderSrc);
+    copyShaderProgram_ = linkProgram(vertexShader, copyFragmentShader);
+
+    // Create single pass program
+    GLuint singlePassFragmentShader = compileShader(GL_FRAGMENT_SHADER, singlePassFragmentShaderSrc);
+    singlePassShaderProgram_ = linkProgram(vertexShader, singlePassFragmentShader);
 
     // Clean up shaders
     glDeleteShader(vertexShader);
     glDeleteShader(horizontalFragmentShader);
     glDeleteShader(verticalFragmentShader);
+    glDeleteShader(copyFragmentShader);
+    glDeleteShader(singlePassFragmentShader);
+
+    // Uniform locations don't change after linking, look them up once
+    horizontalUniforms_ = lookupUniforms(horizontalShaderProgram_);
+    verticalUniforms_ = lookupUniforms(verticalShaderProgram_);
+    copyUniforms_ = lookupUniforms(copyShaderProgram_);
+    singlePassUniforms_ = lookupUniforms(singlePassShaderProgram_);
 }
\ No newline at end of file
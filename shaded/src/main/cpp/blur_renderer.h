@@ -3,6 +3,7 @@
 
 #include <GLES2/gl2.h>
 #include "egl_helper.h"
+#include "pixel_format.h"
 // Include your EGL helper header
 // #include "egl_helper.h"
 
@@ -12,9 +13,30 @@ public:
     ~BlurRenderer() = default;
 
     void initialize();
-    GLuint uploadBitmapAsTexture(unsigned char* pixels, int width, int height);
-    void render(GLuint textureId, int width, int height, float radius);
-    void readFBO(unsigned char* pixels, int width, int height);
+    // stride is the row size in bytes of pixels
+    GLuint uploadBitmapAsTexture(const unsigned char* pixels, int width, int height,
+                                 PixelFormat format, int stride);
+    // Renders at full resolution, except for the final pass which renders 1 / downscale per axis.
+    // readFBO then reads outputWidth() x outputHeight() pixels.
+    void render(GLuint textureId, int width, int height, float radius, int downscale);
+    // Like render, but the final pass draws into framebuffer, e.g. one of a SharedImage, which
+    // must be outputWidth() x outputHeight(). readFBO and renderScrolled don't see that result.
+    void renderInto(GLuint textureId, int width, int height, float radius, int downscale, GLuint framebuffer);
+
+    // Blurs a frame of scrolling content by reusing the previous output of the same frameKey.
+    // The new frame is the previous one moved by (scrollX, scrollY) pixels, i.e.
+    // new(x, y) = previous(x + scrollX, y + scrollY), plus newly exposed content. Only the exposed
+    // strips and a kernel radius wide seam are blurred again, everything else is a shifted copy.
+    // Falls back to a full render when there is no matching previous frame.
+    void renderScrolled(GLuint textureId, int width, int height, float radius,
+                        long long frameKey, int scrollX, int scrollY);
+    // Blurs always render into RGBA8888 targets, read back natively in format where GL can
+    void readFBO(unsigned char* pixels, int width, int height, PixelFormat format, int stride);
+
+    int outputWidth() const { return outputWidth_; }
+    int outputHeight() const { return outputHeight_; }
+    // Number of times the framebuffer textures were (re)allocated, they are reused while sizes repeat
+    int framebufferAllocations() const { return framebufferAllocations_; }
 
 private:
     // EGL and OpenGL setup
@@ -24,39 +46,73 @@ private:
     GLuint quadVBO_;
     GLuint horizontalShaderProgram_;
     GLuint verticalShaderProgram_;
+    GLuint copyShaderProgram_;
+    GLuint singlePassShaderProgram_;
 
-    // Shader attributes and uniforms
+    // Shader attributes and uniforms. Attribute locations are bound to the same indices in every
+    // program and uniform locations are looked up once after linking.
+    struct ProgramUniforms {
+        GLint radius;
+        GLint textureSize;
+        GLint offset;
+        GLint kernel;
+        GLint texelSize;
+    };
     GLint attrPos_;
     GLint attrTexCoord_;
-    GLint uniformTexture_;
-    GLint uniformRadius_;
-    GLint uniformTextureSize_;
-    GLint uniformDirection_;
+    ProgramUniforms horizontalUniforms_;
+    ProgramUniforms verticalUniforms_;
+    ProgramUniforms copyUniforms_;
+    ProgramUniforms singlePassUniforms_;
+
     EGLHelper eglHelper_;  // Offscreen EGL context manager
     // Framebuffers for two-pass rendering
     GLuint framebuffer1_;  // For horizontal pass output
     GLuint framebuffer2_;  // For vertical pass output
+    GLuint framebuffer3_;  // Second vertical pass output, ping-pongs with framebuffer2_ when scrolling
     GLuint fboTexture1_;   // Intermediate texture
     GLuint fboTexture2_;   // Final output texture
+    GLuint fboTexture3_;   // Final output texture of framebuffer3_
+
+    // Output of the latest render, read back by readFBO
+    GLuint outputFramebuffer_;
+    GLuint outputTexture_;
+
+    // What the latest output holds, for reuse by renderScrolled
+    long long previousFrameKey_;
+    float previousRadius_;
+    bool hasPreviousFrame_;
 
     // Current framebuffer dimensions
     int currentWidth_;
     int currentHeight_;
+    int outputWidth_;   // Output framebuffers and the intermediate width may be downscaled
+    int outputHeight_;
+    int intermediateWidth_;   // fboTexture1_ is only allocated once a two-pass blur needs it
+    int intermediateHeight_;
+    int framebufferAllocations_;
 
     bool initialized_;
 
     // Helper methods
     void setupFullscreenQuad();
     void setupFramebuffers();
-    void resizeFramebuffers(int width, int height);
+    void resizeFramebuffers(int width, int height, int outputWidth, int outputHeight);
+    void resizeIntermediate(int width, int height);
     void compileShaders();
     GLuint compileShader(GLenum type, const char* source);
+    GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader);
+    ProgramUniforms lookupUniforms(GLuint program);
 
     // Rendering passes
     void renderHorizontalPass(GLuint textureId, int width, int height, float radius);
     void renderVerticalPass(int width, int height, float radius);
     void renderDirect(GLuint textureId, int width, int height);
-    void drawQuad(GLuint shaderProgram);
+    void renderSinglePass(GLuint textureId, int width, int height, float radius);
+    void renderShiftedCopy(GLuint sourceTexture, int width, int height, int offsetX, int offsetY);
+    void renderRegion(GLuint textureId, int width, int height, float radius,
+                      int x0, int y0, int x1, int y1);
+    void drawQuad();
 };
 
 #endif // BLUR_RENDERER_H
@@ -0,0 +1,71 @@
+#include "blur_scheduler.h"
+#include <chrono>
+
+BlurJobScheduler::BlurJobScheduler(Executor executor) : executor_(std::move(executor)) {}
+
+void BlurJobScheduler::submit(BlurJob job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++stats_.submitted;
+
+        auto existing = waiting_.find(job.surfaceId);
+        if (existing != waiting_.end()) {
+            ++stats_.coalesced;
+            coalesced_.push_back(std::move(existing->second));
+            existing->second = std::move(job);
+        } else {
+            int64_t surfaceId = job.surfaceId;
+            waiting_.emplace(surfaceId, std::move(job));
+        }
+    }
+
+    executor_([this] { drain(); });
+}
+
+BlurJobStats BlurJobScheduler::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+int64_t BlurJobScheduler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void BlurJobScheduler::drain() {
+    std::vector<BlurJob> coalesced;
+    std::vector<BlurJob> expired;
+    BlurJob next;
+    bool hasNext = false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        coalesced.swap(coalesced_);
+
+        int64_t time = now();
+        while (!waiting_.empty()) {
+            auto earliest = waiting_.begin();
+            for (auto it = waiting_.begin(); it != waiting_.end(); ++it) {
+                if (it->second.deadlineNanos < earliest->second.deadlineNanos) earliest = it;
+            }
+
+            BlurJob job = std::move(earliest->second);
+            waiting_.erase(earliest);
+
+            if (job.deadlineNanos < time) {
+                ++stats_.expired;
+                expired.push_back(std::move(job));
+                continue;
+            }
+
+            ++stats_.started;
+            next = std::move(job);
+            hasNext = true;
+            break;
+        }
+    }
+
+    for (BlurJob& job : coalesced) job.discard(BlurJobOutcome::Coalesced);
+    for (BlurJob& job : expired) job.discard(BlurJobOutcome::Expired);
+    if (hasNext) next.run();
+}
@@ -0,0 +1,76 @@
+#ifndef BLUR_SCHEDULER_H
+#define BLUR_SCHEDULER_H
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Why a job ended. Only Completed and Failed jobs ran, the scheduler reports the other two.
+enum class BlurJobOutcome {
+    Completed = 0,
+    Failed = 1,
+    // A newer job for the same surface was submitted before this one started
+    Coalesced = 2,
+    // Its deadline passed before it could start
+    Expired = 3,
+};
+
+struct BlurJob {
+    // Caller chosen ID of what the result is drawn into, only its newest job is worth running
+    int64_t surfaceId;
+    // Latest steady clock time (System.nanoTime on Android) the job is still worth starting at
+    int64_t deadlineNanos;
+    // Runs the blur and reports its result, handling its own errors
+    std::function<void()> run;
+    // Called instead of run, with Coalesced or Expired
+    std::function<void(BlurJobOutcome)> discard;
+};
+
+struct BlurJobStats {
+    uint64_t submitted = 0;
+    uint64_t started = 0;
+    uint64_t coalesced = 0;
+    uint64_t expired = 0;
+};
+
+// Queues blur jobs for a single executor thread (the render thread), so that work nobody will
+// draw never reaches the GPU. Each surface has at most one waiting job: submitting another one
+// replaces it. Among waiting jobs the one with the earliest deadline starts first, and jobs
+// whose deadline passed while they waited are dropped instead of started. A job that started
+// always runs to completion.
+//
+// run and discard are both called on the executor thread, never with the scheduler locked.
+class BlurJobScheduler {
+public:
+    // Runs a task on the executor thread, in the order they were posted
+    using Executor = std::function<void(std::function<void()>)>;
+
+    explicit BlurJobScheduler(Executor executor);
+
+    BlurJobScheduler(const BlurJobScheduler&) = delete;
+    BlurJobScheduler& operator=(const BlurJobScheduler&) = delete;
+
+    void submit(BlurJob job);
+
+    BlurJobStats stats() const;
+
+    // steady_clock time in nanoseconds, the clock deadlines are compared with
+    static int64_t now();
+
+private:
+    // Posted once per submitted job, starts at most one job
+    void drain();
+
+    Executor executor_;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<int64_t, BlurJob> waiting_;
+    // Coalesced jobs, discarded by the next drain so discard runs on the executor thread
+    std::vector<BlurJob> coalesced_;
+    BlurJobStats stats_;
+};
+
+#endif // BLUR_SCHEDULER_H
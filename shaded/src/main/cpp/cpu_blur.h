@@ -0,0 +1,58 @@
+#ifndef CPU_BLUR_H
+#define CPU_BLUR_H
+
+#include <string>
+#include <vector>
+#include "thread_pool.h"
+
+// Multi-threaded CPU implementation of the same separable Gaussian the GL renderers use
+// (sigma = radius / 2, taps up to |x| <= radius). Works on tightly packed RGBA8888 pixels.
+class CpuBlurRenderer {
+public:
+    explicit CpuBlurRenderer(int threadCount);
+    ~CpuBlurRenderer() = default;
+
+    // Rectangle edge treatment: samples outside the image are clamped to the edge.
+    // input and output may point to the same buffer.
+    void render(const unsigned char* input, int width, int height, float radius,
+                unsigned char* output);
+
+    // Unbounded edge treatment: samples outside the image are transparent and the output
+    // grows by calculatePadding(radius) on every side.
+    void renderUnbounded(const unsigned char* input, int inputWidth, int inputHeight, float radius,
+                         unsigned char* output, int& outputWidth, int& outputHeight);
+
+    static int calculatePadding(float radius);
+
+    // Normalized weights for offsets -ceil(radius) ... ceil(radius), a single tap when there is
+    // nothing to blur
+    static std::vector<float> calculateWeights(float radius);
+
+    int threadCount() const { return pool_.threadCount(); }
+
+    // Times the rectangle blur of a synthetic image with 1 ... maxThreads threads and reports
+    // speedup and parallel efficiency for each thread count.
+    static std::string benchmarkScaling(int width, int height, float radius, int maxThreads);
+
+private:
+    void blur(const unsigned char* input, int inputWidth, int inputHeight, int padding,
+              float radius, bool clampEdges, unsigned char* output);
+
+    void horizontalPass(const unsigned char* input, int inputWidth, int inputHeight,
+                        int outputWidth, int padding, bool clampEdges);
+    void verticalPass(int inputHeight, int outputWidth, int outputHeight, int padding,
+                      bool clampEdges, unsigned char* output);
+
+    void computeKernel(float radius);
+
+    ThreadPool pool_;
+
+    // Normalized weights for offsets -kernelRadius_ ... kernelRadius_
+    std::vector<float> weights_;
+    int kernelRadius_;
+
+    // Horizontal pass output, input height x output width
+    std::vector<unsigned char> intermediate_;
+};
+
+#endif // CPU_BLUR_H
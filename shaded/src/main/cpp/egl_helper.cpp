@@ -1,6 +1,10 @@
 #include "egl_helper.h"
 #include <stdexcept>
 
+// Context last made current on this thread by any EGLHelper, so switching is skipped when it
+// wouldn't change anything
+static thread_local EGLContext currentContext = EGL_NO_CONTEXT;
+
 EGLHelper::EGLHelper(int width, int height)
         : display_(EGL_NO_DISPLAY), context_(EGL_NO_CONTEXT), surface_(EGL_NO_SURFACE) {
     initialize(width, height);
@@ -9,6 +13,7 @@ EGLHelper::EGLHelper(int width, int height)
 EGLHelper::~EGLHelper() {
     if (display_ != EGL_NO_DISPLAY) {
         eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        currentContext = EGL_NO_CONTEXT;
 
         if (context_ != EGL_NO_CONTEXT)
             eglDestroyContext(display_, context_);
@@ -21,9 +26,14 @@ EGLHelper::~EGLHelper() {
 }
 
 void EGLHelper::makeCurrent() {
+    if (currentContext == context_) {
+        return;
+    }
+
     if (!eglMakeCurrent(display_, surface_, surface_, context_)) {
         throw std::runtime_error("eglMakeCurrent failed.");
     }
+    currentContext = context_;
 }
 
 void EGLHelper::initialize(int width, int height) {
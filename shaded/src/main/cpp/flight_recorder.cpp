@@ -0,0 +1,171 @@
+#include "flight_recorder.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <ctime>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef __ANDROID__
+#include <android/trace.h>
+#endif
+
+static_assert((FlightRecorder::kCapacity & (FlightRecorder::kCapacity - 1)) == 0,
+              "Capacity must be a power of two");
+
+namespace {
+    const char* const kStageNames[kBlurStageCount] = {"cache lookup", "upload", "render", "readback", "cache store"};
+    const char* const kBackendNames[] = {"gl", "cpu", "vulkan", "hybrid", "disk cache"};
+    const char* const kCacheOutcomeNames[] = {"off", "hit", "miss"};
+    const char* const kPoolOutcomeNames[] = {"unknown", "reused", "reallocated"};
+
+    // ATrace_isEnabled is a cheap check of a cached property, sections are only opened while a
+    // capture is running
+    bool beginSection(const char* name) {
+#ifdef __ANDROID__
+        if (ATrace_isEnabled()) {
+            ATrace_beginSection(name);
+            return true;
+        }
+#else
+        (void) name;
+#endif
+        return false;
+    }
+
+    void endSection(bool traced) {
+#ifdef __ANDROID__
+        if (traced) ATrace_endSection();
+#else
+        (void) traced;
+#endif
+    }
+
+    void appendf(std::string& out, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+    void appendf(std::string& out, const char* format, ...) {
+        char buffer[512];
+        va_list arguments;
+        va_start(arguments, format);
+        int length = std::vsnprintf(buffer, sizeof(buffer), format, arguments);
+        va_end(arguments);
+        if (length > 0) out.append(buffer, std::min(static_cast<size_t>(length), sizeof(buffer) - 1));
+    }
+}
+
+FlightRecorder& FlightRecorder::instance() {
+    static FlightRecorder* recorder = new FlightRecorder();
+    return *recorder;
+}
+
+int64_t FlightRecorder::now() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return static_cast<int64_t>(time.tv_sec) * 1000000000LL + time.tv_nsec;
+}
+
+uint32_t FlightRecorder::currentThread() {
+    static thread_local uint32_t thread = static_cast<uint32_t>(syscall(SYS_gettid));
+    return thread;
+}
+
+void FlightRecorder::record(const BlurTraceEvent& event) {
+    uint64_t ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = slots_[ticket & (kCapacity - 1)];
+
+    // Odd while being written, 2 * ticket + 2 once published
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.event = event;
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+}
+
+std::vector<BlurTraceEvent> FlightRecorder::snapshot() const {
+    uint64_t end = next_.load(std::memory_order_acquire);
+    uint64_t begin = end > kCapacity ? end - kCapacity : 0;
+
+    std::vector<BlurTraceEvent> events;
+    events.reserve(end - begin);
+    for (uint64_t ticket = begin; ticket < end; ++ticket) {
+        const Slot& slot = slots_[ticket & (kCapacity - 1)];
+        uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != 2 * ticket + 2) continue; // Still being written, or already overwritten
+
+        BlurTraceEvent event = slot.event;
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) != sequence) continue;
+        events.push_back(event);
+    }
+    return events;
+}
+
+std::string FlightRecorder::toChromeTraceJson() const {
+    std::vector<BlurTraceEvent> events = snapshot();
+    int process = static_cast<int>(getpid());
+
+    std::string json = "{\"traceEvents\":[";
+    bool first = true;
+    auto separator = [&] {
+        if (!first) json += ",";
+        first = false;
+    };
+
+    for (const BlurTraceEvent& event : events) {
+        separator();
+        appendf(json,
+                "{\"name\":\"blur %s %dx%d\",\"cat\":\"shaded\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"width\":%d,\"height\":%d,\"radius\":%.2f,"
+                "\"edge\":\"%s\",\"backend\":\"%s\",\"cache\":\"%s\",\"pool\":\"%s\"}}",
+                event.edgeMode == BlurEdgeMode::Unbounded ? "unbounded" : "rectangle",
+                event.width, event.height, process, event.thread,
+                event.startNanos / 1000.0, (event.endNanos - event.startNanos) / 1000.0,
+                event.width, event.height, event.radius,
+                event.edgeMode == BlurEdgeMode::Unbounded ? "unbounded" : "rectangle",
+                kBackendNames[static_cast<int>(event.backend)],
+                kCacheOutcomeNames[static_cast<int>(event.cacheOutcome)],
+                kPoolOutcomeNames[static_cast<int>(event.poolOutcome)]);
+
+        for (int stage = 0; stage < kBlurStageCount; ++stage) {
+            if (event.stageStartNanos[stage] == 0) continue;
+            separator();
+            appendf(json,
+                    "{\"name\":\"%s\",\"cat\":\"shaded\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    kStageNames[stage], process, event.stageThread[stage],
+                    event.stageStartNanos[stage] / 1000.0,
+                    (event.stageEndNanos[stage] - event.stageStartNanos[stage]) / 1000.0);
+        }
+    }
+
+    json += "],\"displayTimeUnit\":\"ms\"}";
+    return json;
+}
+
+BlurTrace::BlurTrace(int width, int height, float radius, BlurEdgeMode edgeMode)
+        : event_(), traced_(beginSection("Shaded blur")) {
+    event_.startNanos = FlightRecorder::now();
+    event_.thread = FlightRecorder::currentThread();
+    event_.width = width;
+    event_.height = height;
+    event_.radius = radius;
+    event_.edgeMode = edgeMode;
+    event_.backend = BlurBackend::Gl;
+    event_.cacheOutcome = CacheOutcome::Off;
+    event_.poolOutcome = PoolOutcome::Unknown;
+}
+
+BlurTrace::~BlurTrace() {
+    event_.endNanos = FlightRecorder::now();
+    FlightRecorder::instance().record(event_);
+    endSection(traced_);
+}
+
+BlurTrace::Stage::Stage(BlurTrace& trace, BlurStage stage)
+        : trace_(trace), index_(static_cast<int>(stage)), traced_(beginSection(kStageNames[index_])) {
+    trace_.event_.stageThread[index_] = FlightRecorder::currentThread();
+    trace_.event_.stageStartNanos[index_] = FlightRecorder::now();
+}
+
+BlurTrace::Stage::~Stage() {
+    trace_.event_.stageEndNanos[index_] = FlightRecorder::now();
+    endSection(traced_);
+}
@@ -0,0 +1,102 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "blur_edge_mode.h"
+
+enum class BlurBackend : uint8_t { Gl, Cpu, Vulkan, Hybrid, DiskCache };
+enum class CacheOutcome : uint8_t { Off, Hit, Miss };
+// Whether the renderer's framebuffers could be reused or had to be reallocated for this size
+enum class PoolOutcome : uint8_t { Unknown, Reused, Reallocated };
+enum class BlurStage : uint8_t { CacheLookup, Upload, Render, Readback, CacheStore };
+constexpr int kBlurStageCount = 5;
+
+// One blur call. Timestamps are CLOCK_MONOTONIC nanoseconds, 0 for stages that didn't run.
+struct BlurTraceEvent {
+    int64_t startNanos;
+    int64_t endNanos;
+    int64_t stageStartNanos[kBlurStageCount];
+    int64_t stageEndNanos[kBlurStageCount];
+    uint32_t stageThread[kBlurStageCount];
+    uint32_t thread;
+    int32_t width;
+    int32_t height;
+    float radius;
+    BlurEdgeMode edgeMode;
+    BlurBackend backend;
+    CacheOutcome cacheOutcome;
+    PoolOutcome poolOutcome;
+};
+
+// Always-on ring of the latest kCapacity blur calls, so a jank report can include what the blur
+// engine was doing in the frames before it. Writers never block or allocate: a slot is claimed
+// with one atomic increment and published with a per-slot sequence number, readers copy a slot
+// and drop it if its sequence changed meanwhile.
+class FlightRecorder {
+public:
+    static constexpr uint64_t kCapacity = 512;
+
+    static FlightRecorder& instance();
+
+    void record(const BlurTraceEvent& event);
+
+    // Recorded events, oldest first
+    std::vector<BlurTraceEvent> snapshot() const;
+
+    // Chrome / Perfetto trace JSON (trace event format) of snapshot(), one complete event per
+    // blur call and one per stage, on the threads that ran them
+    std::string toChromeTraceJson() const;
+
+    static int64_t now();
+    static uint32_t currentThread();
+
+private:
+    FlightRecorder() : next_(0) {}
+
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};
+        BlurTraceEvent event;
+    };
+
+    std::atomic<uint64_t> next_;
+    Slot slots_[kCapacity];
+};
+
+// Collects one blur call on the stack and records it when it goes out of scope. Also emits
+// ATrace sections for the call and its stages while systrace / Perfetto is capturing.
+class BlurTrace {
+public:
+    BlurTrace(int width, int height, float radius, BlurEdgeMode edgeMode);
+    ~BlurTrace();
+
+    BlurTrace(const BlurTrace&) = delete;
+    BlurTrace& operator=(const BlurTrace&) = delete;
+
+    void setBackend(BlurBackend backend) { event_.backend = backend; }
+    void setCacheOutcome(CacheOutcome outcome) { event_.cacheOutcome = outcome; }
+    void setPoolOutcome(PoolOutcome outcome) { event_.poolOutcome = outcome; }
+
+    // Times one stage on whichever thread runs it, e.g. inside a render thread task
+    class Stage {
+    public:
+        Stage(BlurTrace& trace, BlurStage stage);
+        ~Stage();
+
+        Stage(const Stage&) = delete;
+        Stage& operator=(const Stage&) = delete;
+
+    private:
+        BlurTrace& trace_;
+        int index_;
+        bool traced_;
+    };
+
+private:
+    BlurTraceEvent event_;
+    bool traced_;
+};
+
+#endif // FLIGHT_RECORDER_H
@@ -0,0 +1,215 @@
+#include "hybrid_blur.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace {
+    // Weight of the latest measurement in the smoothed throughput
+    constexpr double kThroughputSmoothing = 0.25;
+
+    double steadySeconds() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+}
+
+HybridBlurScheduler::HybridBlurScheduler(BandRenderer gpuRenderer, BandRenderer cpuRenderer, Clock clock)
+        : gpuRenderer_(std::move(gpuRenderer)), cpuRenderer_(std::move(cpuRenderer)),
+          clock_(clock ? std::move(clock) : Clock(steadySeconds)),
+          gpuShare_(0.5f), gpuThroughput_(0.0), cpuThroughput_(0.0), blursSinceProbe_(0),
+          gpuFailed_(false), workerBusy_(false), stopping_(false),
+          worker_(&HybridBlurScheduler::workerLoop, this) {}
+
+HybridBlurScheduler::~HybridBlurScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_all();
+    worker_.join();
+}
+
+int HybridBlurScheduler::calculateHalo(float radius) {
+    return radius <= 0.5f ? 0 : static_cast<int>(std::ceil(radius));
+}
+
+void HybridBlurScheduler::render(const unsigned char* input, int width, int height, float radius,
+                                 unsigned char* output) {
+    int halo = calculateHalo(radius);
+    int gpuRows = planGpuRows(height, halo);
+
+    if (gpuRows == height && renderGpu(input, width, height, radius, output)) return;
+    if (gpuRows == 0 || gpuRows == height) {
+        renderCpu(input, width, height, radius, output);
+        return;
+    }
+    renderSplit(input, width, height, radius, output, gpuRows, halo);
+}
+
+int HybridBlurScheduler::planGpuRows(int height, int halo) {
+    if (gpuFailed_) return 0;
+
+    float share = gpuShare_;
+    bool probe = ++blursSinceProbe_ >= kProbeInterval;
+    if (share < kMinShare) {
+        if (!probe) return 0;
+        share = kMinShare;
+    } else if (share > 1.0f - kMinShare) {
+        if (!probe) return height;
+        share = 1.0f - kMinShare;
+    }
+
+    // Bands barely taller than their halos blur most rows twice, leave such images to one side
+    if (height < 4 * std::max(halo, 1)) {
+        return share >= 0.5f ? height : 0;
+    }
+
+    blursSinceProbe_ = 0;
+    int rows = static_cast<int>(std::lround(height * share));
+    if (height > 2 * kBandRowStep) {
+        rows = (rows + kBandRowStep / 2) / kBandRowStep * kBandRowStep;
+    }
+    return std::min(std::max(rows, 1), height - 1);
+}
+
+bool HybridBlurScheduler::renderGpu(const unsigned char* input, int width, int height, float radius,
+                                    unsigned char* output) {
+    double start = clock_();
+    try {
+        gpuRenderer_(input, width, height, radius, output);
+    } catch (const std::exception&) {
+        gpuFailed_ = true;
+        gpuShare_ = 0.0f;
+        return false;
+    }
+    updateThroughput(gpuThroughput_, static_cast<double>(width) * height, clock_() - start);
+    updateShare();
+    return true;
+}
+
+void HybridBlurScheduler::renderCpu(const unsigned char* input, int width, int height, float radius,
+                                    unsigned char* output) {
+    double start = clock_();
+    cpuRenderer_(input, width, height, radius, output);
+    updateThroughput(cpuThroughput_, static_cast<double>(width) * height, clock_() - start);
+    updateShare();
+}
+
+void HybridBlurScheduler::renderSplit(const unsigned char* input, int width, int height, float radius,
+                                      unsigned char* output, int gpuRows, int halo) {
+    Band gpuBand{0, gpuRows, 0, std::min(height, gpuRows + halo)};
+    Band cpuBand{gpuRows, height, std::max(0, gpuRows - halo), height};
+
+    // Both bands read each other's halo, so nothing is written to output until both are done
+    double cpuSeconds = 0.0;
+    startWorker([&] {
+        cpuSeconds = renderBand(cpuRenderer_, input, width, radius, cpuBand, cpuBand_);
+    });
+
+    double gpuSeconds = 0.0;
+    bool gpuDone = true;
+    try {
+        gpuSeconds = renderBand(gpuRenderer_, input, width, radius, gpuBand, gpuBand_);
+    } catch (const std::exception&) {
+        gpuDone = false;
+    }
+    waitForWorker();
+
+    updateThroughput(cpuThroughput_, static_cast<double>(width) * (cpuBand.inputLastRow - cpuBand.inputFirstRow),
+                     cpuSeconds);
+
+    if (!gpuDone) {
+        gpuFailed_ = true;
+        gpuShare_ = 0.0f;
+        // The CPU band doesn't cover the GPU rows, blur those again on the CPU with their halo
+        renderBand(cpuRenderer_, input, width, radius, gpuBand, gpuBand_);
+    } else {
+        updateThroughput(gpuThroughput_, static_cast<double>(width) * (gpuBand.inputLastRow - gpuBand.inputFirstRow),
+                         gpuSeconds);
+        updateShare();
+    }
+
+    copyBand(gpuBand_, width, gpuBand, output);
+    copyBand(cpuBand_, width, cpuBand, output);
+}
+
+double HybridBlurScheduler::renderBand(const BandRenderer& renderer, const unsigned char* input, int width,
+                                       float radius, const Band& band, std::vector<unsigned char>& bandOutput) const {
+    int inputRows = band.inputLastRow - band.inputFirstRow;
+    bandOutput.resize(static_cast<size_t>(width) * inputRows * 4);
+
+    double start = clock_();
+    renderer(input + static_cast<size_t>(band.inputFirstRow) * width * 4, width, inputRows, radius,
+             bandOutput.data());
+    return clock_() - start;
+}
+
+void HybridBlurScheduler::copyBand(const std::vector<unsigned char>& bandOutput, int width, const Band& band,
+                                   unsigned char* output) {
+    size_t rowBytes = static_cast<size_t>(width) * 4;
+    std::memcpy(output + band.firstRow * rowBytes,
+                bandOutput.data() + (band.firstRow - band.inputFirstRow) * rowBytes,
+                (band.lastRow - band.firstRow) * rowBytes);
+}
+
+void HybridBlurScheduler::updateThroughput(double& throughput, double pixels, double seconds) {
+    if (seconds <= 0.0) return;
+    double measured = pixels / seconds;
+    throughput = throughput == 0.0 ? measured
+                                   : throughput + kThroughputSmoothing * (measured - throughput);
+}
+
+void HybridBlurScheduler::updateShare() {
+    // Until both sides have been measured, split evenly so both get measured
+    if (gpuFailed_ || gpuThroughput_ == 0.0 || cpuThroughput_ == 0.0) return;
+
+    // Rows proportional to throughput make both bands finish at the same time
+    gpuShare_ = static_cast<float>(gpuThroughput_ / (gpuThroughput_ + cpuThroughput_));
+}
+
+void HybridBlurScheduler::startWorker(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        workerTask_ = std::move(task);
+        workerError_ = nullptr;
+        workerBusy_ = true;
+    }
+    condition_.notify_all();
+}
+
+void HybridBlurScheduler::waitForWorker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return !workerBusy_; });
+    if (workerError_) {
+        std::exception_ptr error = workerError_;
+        workerError_ = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void HybridBlurScheduler::workerLoop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stopping_ || workerTask_; });
+            if (stopping_) return;
+            task = std::move(workerTask_);
+            workerTask_ = nullptr;
+        }
+
+        std::exception_ptr error;
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            workerError_ = error;
+            workerBusy_ = false;
+        }
+        condition_.notify_all();
+    }
+}
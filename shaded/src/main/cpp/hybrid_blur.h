@@ -0,0 +1,108 @@
+#ifndef HYBRID_BLUR_H
+#define HYBRID_BLUR_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Splits one rectangle blur between the GPU and the CPU by bands of rows: the top band goes to
+// the GPU renderer, the bottom one to the CPU renderer, both at the same time. Each band is
+// blurred together with a halo of calculateHalo(radius) rows of its neighbour, so the seam
+// matches a blur of the whole image exactly.
+//
+// The split follows the throughput measured for each side (pixels per second, smoothed over
+// recent blurs). A side whose share drops below kMinShare is left out entirely and only probed
+// with a small band every kProbeInterval blurs, so it can win its share back when the other side
+// gets busy. A GPU renderer that throws is left out for good. On images taller than two
+// kBandRowStep, the split is snapped to whole steps so that the GPU band keeps its height while
+// the share wavers, and the GPU renderer can keep its framebuffers.
+//
+// Not thread safe, callers serialize render().
+class HybridBlurScheduler {
+public:
+    // Blurs width x height tightly packed RGBA8888 pixels with the rectangle edge treatment.
+    // input and output may point to the same buffer.
+    using BandRenderer = std::function<void(const unsigned char* input, int width, int height,
+                                            float radius, unsigned char* output)>;
+
+    // Seconds on a monotonic clock, read on the thread that runs the band being timed
+    using Clock = std::function<double()>;
+
+    static constexpr float kMinShare = 0.05f;
+    static constexpr int kProbeInterval = 32;
+    static constexpr int kBandRowStep = 64;
+
+    // gpuRenderer runs on the thread calling render(), cpuRenderer on the scheduler's own thread.
+    // Bands are timed with steady_clock unless another clock is given.
+    HybridBlurScheduler(BandRenderer gpuRenderer, BandRenderer cpuRenderer, Clock clock = nullptr);
+    ~HybridBlurScheduler();
+
+    HybridBlurScheduler(const HybridBlurScheduler&) = delete;
+    HybridBlurScheduler& operator=(const HybridBlurScheduler&) = delete;
+
+    // input and output may point to the same buffer
+    void render(const unsigned char* input, int width, int height, float radius, unsigned char* output);
+
+    // Share of rows the next split gives the GPU
+    float gpuShare() const { return gpuShare_; }
+    // Smoothed pixels per second of each side, 0 until it ran once
+    double gpuThroughput() const { return gpuThroughput_; }
+    double cpuThroughput() const { return cpuThroughput_; }
+    bool gpuFailed() const { return gpuFailed_; }
+
+    // Rows of the neighbouring band each band needs to blur its own rows exactly
+    static int calculateHalo(float radius);
+
+private:
+    // Output rows [firstRow, lastRow) are blurred from input rows [inputFirstRow, inputLastRow)
+    struct Band {
+        int firstRow;
+        int lastRow;
+        int inputFirstRow;
+        int inputLastRow;
+    };
+
+    int planGpuRows(int height, int halo);
+    bool renderGpu(const unsigned char* input, int width, int height, float radius, unsigned char* output);
+    void renderCpu(const unsigned char* input, int width, int height, float radius, unsigned char* output);
+    void renderSplit(const unsigned char* input, int width, int height, float radius,
+                     unsigned char* output, int gpuRows, int halo);
+    double renderBand(const BandRenderer& renderer, const unsigned char* input, int width,
+                      float radius, const Band& band, std::vector<unsigned char>& bandOutput) const;
+    static void copyBand(const std::vector<unsigned char>& bandOutput, int width, const Band& band,
+                         unsigned char* output);
+
+    void updateThroughput(double& throughput, double pixels, double seconds);
+    void updateShare();
+
+    // Single worker thread for the CPU side, so the GPU side can stay on the caller's thread
+    void startWorker(std::function<void()> task);
+    void waitForWorker();
+    void workerLoop();
+
+    BandRenderer gpuRenderer_;
+    BandRenderer cpuRenderer_;
+    Clock clock_;
+
+    std::vector<unsigned char> gpuBand_;
+    std::vector<unsigned char> cpuBand_;
+
+    float gpuShare_;
+    double gpuThroughput_;
+    double cpuThroughput_;
+    int blursSinceProbe_;
+    bool gpuFailed_;
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::function<void()> workerTask_;
+    std::exception_ptr workerError_;
+    bool workerBusy_;
+    bool stopping_;
+    std::thread worker_;
+};
+
+#endif // HYBRID_BLUR_H
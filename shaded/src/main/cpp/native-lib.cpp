@@ -1,25 +1,650 @@
 #include <jni.h>
 #include <GLES2/gl2.h>
 #include <android/bitmap.h>
+#include <android/log.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <cstring>
+#include <dlfcn.h>
+#include <vector>
+#include "blur_disk_cache.h"
+#include "blur_edge_mode.h"
 #include "blur_renderer.h"
+#include "blur_scheduler.h"
+#include "cpu_blur.h"
+#include "flight_recorder.h"
+#include "hybrid_blur.h"
+#include "pixel_format.h"
+#include "readback_scale.h"
+#include "render_thread.h"
+#include "shared_image.h"
+#include "streaming_blur.h"
 #include "unbounded_blur.h"
+#if SHADED_VULKAN
+#include "vulkan_blur.h"
+#endif
 
-static BlurRenderer rectangleRenderer(200, 200);
-static UnboundedBlurRenderer unboundedRenderer(200, 200);
+#define LOG_TAG "Shaded"
+
+static JavaVM* javaVM = nullptr;
+
+// All GL work runs on the render thread, created with the first blur (or by prewarm)
+static RenderThread& renderThread() {
+    static RenderThread* thread = new RenderThread();
+    return *thread;
+}
+
+// Renderers are created on first use (or by prewarm) instead of at library load, so that
+// System.loadLibrary doesn't pay for eglInitialize, context creation and shader compilation.
+static std::unique_ptr<BlurRenderer> rectangleRendererInstance;
+static std::unique_ptr<UnboundedBlurRenderer> unboundedRendererInstance;
+
+// Only call on the render thread
+static BlurRenderer& rectangleRenderer() {
+    if (!rectangleRendererInstance) {
+        rectangleRendererInstance = std::make_unique<BlurRenderer>(200, 200);
+    }
+    return *rectangleRendererInstance;
+}
+
+// Only call on the render thread
+static UnboundedBlurRenderer& unboundedRenderer() {
+    if (!unboundedRendererInstance) {
+        unboundedRendererInstance = std::make_unique<UnboundedBlurRenderer>(200, 200);
+    }
+    return *unboundedRendererInstance;
+}
+
+static std::atomic<bool> vulkanEnabled(false);
+#if SHADED_VULKAN
+// Vulkan compute renderer, used for RGBA8888 blurs once enabled. Created on the render thread
+// like the GL renderers, and never again after it failed once.
+static std::unique_ptr<VulkanBlurRenderer> vulkanRendererInstance;
+static std::atomic<bool> vulkanUnavailable(false);
+
+// Only call on the render thread, returns null when Vulkan isn't enabled or available
+static VulkanBlurRenderer* vulkanRenderer() {
+    if (!vulkanEnabled.load() || vulkanUnavailable.load()) return nullptr;
+    if (!vulkanRendererInstance) {
+        try {
+            vulkanRendererInstance = std::make_unique<VulkanBlurRenderer>();
+            __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "Vulkan blur on %s",
+                                vulkanRendererInstance->deviceName());
+        } catch (const std::runtime_error& e) {
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Vulkan blur unavailable: %s", e.what());
+            vulkanUnavailable = true;
+        }
+    }
+    return vulkanRendererInstance.get();
+}
+
+// Only call on the render thread. A blur that failed once would most likely fail again, so
+// Vulkan isn't tried again and blurs stay on GL from now on.
+static void disableFailedVulkan(const std::runtime_error& e) {
+    __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Vulkan blur failed, using GL instead: %s", e.what());
+    vulkanUnavailable = true;
+    vulkanRendererInstance.reset();
+}
+#endif
+
+// JNIEnv of the render thread, which stays attached to the VM for its whole life. Null only if
+// the thread can't be attached, which is logged since async blurs can't report back then.
+static JNIEnv* renderThreadEnv() {
+    static thread_local JNIEnv* env = nullptr;
+    if (env) return env;
+    if (javaVM->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) == JNI_OK) return env;
+    if (javaVM->AttachCurrentThread(&env, nullptr) != JNI_OK) {
+        env = nullptr;
+        __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Couldn't attach the render thread to the VM");
+    }
+    return env;
+}
+
+// Async blurs of the modifier, coalesced per surface before they reach the render thread
+static BlurJobScheduler& blurScheduler() {
+    static BlurJobScheduler* scheduler = new BlurJobScheduler([](std::function<void()> task) {
+        renderThread().post(std::move(task));
+    });
+    return *scheduler;
+}
+
+static std::mutex cpuRendererMutex;
+static std::unique_ptr<CpuBlurRenderer> cpuRendererInstance;
+
+// Callers must hold cpuRendererMutex
+static CpuBlurRenderer& cpuRenderer() {
+    if (!cpuRendererInstance) {
+        cpuRendererInstance = std::make_unique<CpuBlurRenderer>(
+                static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+    }
+    return *cpuRendererInstance;
+}
+
+// Splits rectangle blurs between the GL renderer and the CPU renderer once enabled
+static std::atomic<bool> hybridEnabled(false);
+static std::unique_ptr<HybridBlurScheduler> hybridSchedulerInstance;
+// The GPU band has its own renderer, so that it keeps its framebuffers between hybrid blurs
+// whatever size the other rectangle blurs are
+static std::unique_ptr<BlurRenderer> hybridBandRendererInstance;
+
+// Render thread only. The GPU band then runs inline, a lock held across a wait for the render
+// thread would deadlock with async blurs running on it.
+static HybridBlurScheduler& hybridScheduler() {
+    if (!hybridSchedulerInstance) {
+        auto gpuBand = [](const unsigned char* input, int width, int height, float radius, unsigned char* output) {
+            if (!hybridBandRendererInstance) {
+                hybridBandRendererInstance = std::make_unique<BlurRenderer>(width, height);
+            }
+            BlurRenderer& renderer = *hybridBandRendererInstance;
+            GLuint texId = renderer.uploadBitmapAsTexture(input, width, height, PixelFormat::Rgba8888, width * 4);
+            renderer.render(texId, width, height, radius, 1);
+            renderer.readFBO(output, width, height, PixelFormat::Rgba8888, width * 4);
+            glDeleteTextures(1, &texId);
+        };
+        auto cpuBand = [](const unsigned char* input, int width, int height, float radius, unsigned char* output) {
+            std::lock_guard<std::mutex> lock(cpuRendererMutex);
+            cpuRenderer().render(input, width, height, radius, output);
+        };
+        hybridSchedulerInstance = std::make_unique<HybridBlurScheduler>(gpuBand, cpuBand);
+    }
+    return *hybridSchedulerInstance;
+}
+
+// Renders rectangle blurs into hardware buffers handed out as hardware bitmaps once enabled,
+// instead of reading them back. Never tried again after the first shared image failed.
+static std::atomic<bool> zeroCopyEnabled(false);
+static std::atomic<bool> zeroCopyUnavailable(false);
+
+// AHardwareBuffer_toHardwareBuffer is API 26, above minSdk, so it's resolved at runtime
+static jobject (*toHardwareBuffer)(JNIEnv*, AHardwareBuffer*) = nullptr;
+
+static bool loadZeroCopyFunctions() {
+    static std::once_flag loaded;
+    std::call_once(loaded, [] {
+        void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (library) {
+            toHardwareBuffer = reinterpret_cast<decltype(toHardwareBuffer)>(
+                    dlsym(library, "AHardwareBuffer_toHardwareBuffer"));
+        }
+    });
+    return toHardwareBuffer != nullptr;
+}
+
+static std::mutex diskCacheMutex;
+static std::shared_ptr<BlurDiskCache> diskCacheInstance;
+
+static std::shared_ptr<BlurDiskCache> diskCache() {
+    std::lock_guard<std::mutex> lock(diskCacheMutex);
+    return diskCacheInstance;
+}
+
+static bool pixelFormatFromAndroid(int32_t androidFormat, PixelFormat& format) {
+    switch (androidFormat) {
+        case ANDROID_BITMAP_FORMAT_RGBA_8888: format = PixelFormat::Rgba8888; return true;
+        case ANDROID_BITMAP_FORMAT_RGB_565: format = PixelFormat::Rgb565; return true;
+        case ANDROID_BITMAP_FORMAT_A_8: format = PixelFormat::Alpha8; return true;
+        case ANDROID_BITMAP_FORMAT_RGBA_F16: format = PixelFormat::RgbaF16; return true;
+        default: return false;
+    }
+}
+
+static jobject createBitmap(JNIEnv* env, int width, int height, PixelFormat format) {
+    const char* configName;
+    switch (format) {
+        case PixelFormat::Rgb565: configName = "RGB_565"; break;
+        case PixelFormat::Alpha8: configName = "ALPHA_8"; break;
+        case PixelFormat::RgbaF16: configName = "RGBA_F16"; break;
+        case PixelFormat::Rgba8888:
+        default: configName = "ARGB_8888"; break;
+    }
+
+    jclass bitmapClass = env->FindClass("android/graphics/Bitmap");
+    jmethodID createBitmapMethod = env->GetStaticMethodID(bitmapClass, "createBitmap",
+                                                          "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
+
+    jclass configClass = env->FindClass("android/graphics/Bitmap$Config");
+    jfieldID configField = env->GetStaticFieldID(configClass, configName, "Landroid/graphics/Bitmap$Config;");
+    jobject config = env->GetStaticObjectField(configClass, configField);
+
+    return env->CallStaticObjectMethod(bitmapClass, createBitmapMethod, width, height, config);
+}
+
+static jobject createArgb8888Bitmap(JNIEnv* env, int width, int height) {
+    return createBitmap(env, width, height, PixelFormat::Rgba8888);
+}
+
+// Locks a bitmap created by createBitmap and reports its row stride
+static unsigned char* lockOutputBitmap(JNIEnv* env, jobject bitmap, int& stride) {
+    AndroidBitmapInfo info;
+    void* pixels;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0 ||
+        AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0) {
+        return nullptr;
+    }
+    stride = static_cast<int>(info.stride);
+    return reinterpret_cast<unsigned char*>(pixels);
+}
+
+static jobject createBitmapFromEntry(JNIEnv* env, const BlurDiskCache::Entry& entry) {
+    jobject bitmap = createArgb8888Bitmap(env, entry.width(), entry.height());
+
+    int stride;
+    unsigned char* bitmapPixels = lockOutputBitmap(env, bitmap, stride);
+    if (!bitmapPixels) {
+        return nullptr;
+    }
+    entry.copyPixels(bitmapPixels, stride);
+    AndroidBitmap_unlockPixels(env, bitmap);
+
+    return bitmap;
+}
+
+// Wraps buffer in a hardware bitmap, which keeps its own reference to it. Needs API 29.
+static jobject wrapHardwareBuffer(JNIEnv* env, AHardwareBuffer* buffer) {
+    jobject hardwareBuffer = toHardwareBuffer(env, buffer);
+    if (!hardwareBuffer) return nullptr;
+
+    jclass colorSpaceClass = env->FindClass("android/graphics/ColorSpace");
+    jclass namedClass = env->FindClass("android/graphics/ColorSpace$Named");
+    jfieldID srgbField = env->GetStaticFieldID(namedClass, "SRGB", "Landroid/graphics/ColorSpace$Named;");
+    jmethodID getMethod = env->GetStaticMethodID(colorSpaceClass, "get",
+                                                 "(Landroid/graphics/ColorSpace$Named;)Landroid/graphics/ColorSpace;");
+    jobject srgb = env->CallStaticObjectMethod(colorSpaceClass, getMethod,
+                                               env->GetStaticObjectField(namedClass, srgbField));
+
+    jclass bitmapClass = env->FindClass("android/graphics/Bitmap");
+    jmethodID wrapMethod = env->GetStaticMethodID(
+            bitmapClass, "wrapHardwareBuffer",
+            "(Landroid/hardware/HardwareBuffer;Landroid/graphics/ColorSpace;)Landroid/graphics/Bitmap;");
+    jobject bitmap = wrapMethod ? env->CallStaticObjectMethod(bitmapClass, wrapMethod, hardwareBuffer, srgb)
+                                : nullptr;
+    // Clear a failed lookup or wrap before any other JNI call, the HardwareBuffer still has to be closed
+    bool failed = env->ExceptionCheck();
+    if (failed) {
+        env->ExceptionClear();
+    }
+
+    jclass hardwareBufferClass = env->GetObjectClass(hardwareBuffer);
+    env->CallVoidMethod(hardwareBuffer, env->GetMethodID(hardwareBufferClass, "close", "()V"));
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+        failed = true;
+    }
+    return failed ? nullptr : bitmap;
+}
+
+// Rectangle blur of pixels whose final pass renders straight into a hardware buffer, returned as
+// a hardware bitmap with no readback. Returns null when zero-copy output isn't used or fails, so
+// the caller falls back to reading back into a bitmap.
+static jobject blurRectangleZeroCopy(JNIEnv* env, const unsigned char* pixels, int width, int height,
+                                     int stride, float radius, int downscale,
+                                     const std::shared_ptr<BlurDiskCache>& cache, uint64_t cacheKey,
+                                     BlurTrace& trace) {
+    if (!zeroCopyEnabled.load() || zeroCopyUnavailable.load()) return nullptr;
+
+    int outputWidth = calculateDownscaledSize(width, downscale);
+    int outputHeight = calculateDownscaledSize(height, downscale);
+
+    std::unique_ptr<SharedImage> image;
+    renderThread().runSync([&] {
+        BlurRenderer& renderer = rectangleRenderer();
+        int allocations = renderer.framebufferAllocations();
+        GLuint texId;
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Upload);
+            texId = renderer.uploadBitmapAsTexture(pixels, width, height, PixelFormat::Rgba8888, stride);
+        }
+
+        image = SharedImage::create(outputWidth, outputHeight);
+        if (image) {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            renderer.renderInto(texId, width, height, radius, downscale, image->framebuffer());
+            image->finishRendering();
+        }
+        glDeleteTextures(1, &texId);
+        trace.setPoolOutcome(renderer.framebufferAllocations() == allocations ? PoolOutcome::Reused
+                                                                               : PoolOutcome::Reallocated);
+    });
+
+    if (!image) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Zero-copy output unavailable, reading blurs back");
+        zeroCopyUnavailable = true;
+        return nullptr;
+    }
+
+    // The cache still needs the pixels, mapped instead of read back
+    if (cache) {
+        BlurTrace::Stage stage(trace, BlurStage::CacheStore);
+        int rowStride;
+        if (const unsigned char* mapped = image->lock(rowStride)) {
+            size_t rowBytes = static_cast<size_t>(outputWidth) * 4;
+            std::vector<unsigned char> packed(rowBytes * outputHeight);
+            for (int y = 0; y < outputHeight; ++y) {
+                std::memcpy(&packed[y * rowBytes], mapped + static_cast<size_t>(y) * rowStride, rowBytes);
+            }
+            image->unlock();
+            cache->store(cacheKey, outputWidth, outputHeight, packed.data(), static_cast<int>(rowBytes));
+        }
+    }
+
+    jobject bitmap = wrapHardwareBuffer(env, image->hardwareBuffer());
+    renderThread().runSync([&] { image.reset(); });
+    if (!bitmap) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Hardware bitmaps unavailable, reading blurs back");
+        zeroCopyUnavailable = true;
+    }
+    return bitmap;
+}
+
+// Blurs tightly packed RGBA8888 pixels in place with the Vulkan renderer. Returns false when
+// Vulkan isn't used or fails, so the caller falls back to GL.
+static bool blurRectangleVulkan(unsigned char* pixels, int width, int height, int stride, float radius,
+                                BlurTrace& trace) {
+#if SHADED_VULKAN
+    if (!vulkanEnabled.load() || vulkanUnavailable.load() || stride != width * 4) return false;
+
+    bool blurred = false;
+    renderThread().runSync([&] {
+        VulkanBlurRenderer* renderer = vulkanRenderer();
+        if (!renderer) return;
+        try {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            int outputWidth, outputHeight;
+            renderer->render(pixels, width, height, radius, BlurEdgeMode::Rectangle, pixels,
+                             outputWidth, outputHeight);
+            blurred = true;
+        } catch (const std::runtime_error& e) {
+            disableFailedVulkan(e);
+        }
+    });
+    if (blurred) trace.setBackend(BlurBackend::Vulkan);
+    return blurred;
+#else
+    return false;
+#endif
+}
+
+// Unbounded blur of tightly packed RGBA8888 pixels with the Vulkan renderer, stored in cache
+// when there is one. Returns null when Vulkan isn't used or fails, so the caller falls back to GL.
+static jobject blurUnboundedVulkan(JNIEnv* env, const unsigned char* pixels, int width, int height,
+                                   int stride, float radius,
+                                   const std::shared_ptr<BlurDiskCache>& cache, uint64_t cacheKey,
+                                   BlurTrace& trace) {
+#if SHADED_VULKAN
+    if (!vulkanEnabled.load() || vulkanUnavailable.load() || stride != width * 4) return nullptr;
+
+    // The renderer is created on first use, which is when Vulkan can turn out to be unavailable.
+    // Only then is it worth allocating the output bitmap.
+    bool available = false;
+    renderThread().runSync([&] { available = vulkanRenderer() != nullptr; });
+    if (!available) return nullptr;
+
+    int padding = VulkanBlurRenderer::calculatePadding(radius);
+    int outputWidth = width + 2 * padding;
+    int outputHeight = height + 2 * padding;
+    jobject outputBitmap = createArgb8888Bitmap(env, outputWidth, outputHeight);
+    int outputStride;
+    unsigned char* outputPixels = lockOutputBitmap(env, outputBitmap, outputStride);
+    if (!outputPixels) return nullptr;
+    if (outputStride != outputWidth * 4) {
+        AndroidBitmap_unlockPixels(env, outputBitmap);
+        return nullptr;
+    }
+
+    bool blurred = false;
+    renderThread().runSync([&] {
+        VulkanBlurRenderer* renderer = vulkanRenderer();
+        if (!renderer) return;
+        try {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            renderer->render(pixels, width, height, radius, BlurEdgeMode::Unbounded, outputPixels,
+                             outputWidth, outputHeight);
+            blurred = true;
+        } catch (const std::runtime_error& e) {
+            disableFailedVulkan(e);
+        }
+    });
+
+    if (blurred) {
+        trace.setBackend(BlurBackend::Vulkan);
+    }
+    if (blurred && cache) {
+        BlurTrace::Stage stage(trace, BlurStage::CacheStore);
+        cache->store(cacheKey, outputWidth, outputHeight, outputPixels, outputStride);
+    }
+    AndroidBitmap_unlockPixels(env, outputBitmap);
+    return blurred ? outputBitmap : nullptr;
+#else
+    return nullptr;
+#endif
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM* vm, void* reserved) {
+    javaVM = vm;
+    return JNI_VERSION_1_6;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_prewarm(JNIEnv* env, jobject thiz) {
+    renderThread().post([] {
+        try {
+            rectangleRenderer().initialize();
+            unboundedRenderer().initialize();
+        } catch (const std::runtime_error& e) {
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Blur prewarm failed: %s", e.what());
+        }
+    });
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_setDiskCache(JNIEnv* env, jobject thiz,
+                                                          jstring directory, jlong maxBytes) {
+    std::shared_ptr<BlurDiskCache> cache;
+    if (directory != nullptr && maxBytes > 0) {
+        const char* path = env->GetStringUTFChars(directory, nullptr);
+        cache = std::make_shared<BlurDiskCache>(path, static_cast<size_t>(maxBytes));
+        env->ReleaseStringUTFChars(directory, path);
+    }
+
+    std::lock_guard<std::mutex> lock(diskCacheMutex);
+    diskCacheInstance = cache;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_setVulkanEnabled(JNIEnv* env, jobject thiz, jboolean enabled) {
+    vulkanEnabled = enabled;
+    if (!enabled) return JNI_FALSE;
+
+#if SHADED_VULKAN
+    // Creates the renderer right away, so the caller learns whether Vulkan is actually used
+    bool available = false;
+    renderThread().runSync([&] { available = vulkanRenderer() != nullptr; });
+    return available ? JNI_TRUE : JNI_FALSE;
+#else
+    return JNI_FALSE;
+#endif
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_setHybridEnabled(JNIEnv* env, jobject thiz, jboolean enabled) {
+    hybridEnabled = enabled;
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_setZeroCopyEnabled(JNIEnv* env, jobject thiz, jboolean enabled) {
+    zeroCopyEnabled = enabled && loadZeroCopyFunctions();
+    return zeroCopyEnabled.load() && !zeroCopyUnavailable.load();
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_dumpTrace(JNIEnv* env, jobject thiz) {
+    std::string json = FlightRecorder::instance().toChromeTraceJson();
+    return env->NewStringUTF(json.c_str());
+}
+
+// Blurs inputBitmap in place and returns it. GL work runs on the render thread, but the
+// bitmap is handled with the env of whichever thread calls this.
+static jobject blurRectangle(JNIEnv* env, jobject inputBitmap, float radius) {
+    AndroidBitmapInfo info;
+    void* pixels;
+    PixelFormat format;
+
+    if (AndroidBitmap_getInfo(env, inputBitmap, &info) < 0) {
+        return nullptr;
+    }
+
+    if (!pixelFormatFromAndroid(info.format, format)) {
+        return nullptr;
+    }
+
+    if (AndroidBitmap_lockPixels(env, inputBitmap, &pixels) < 0) {
+        return nullptr;
+    }
+
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(pixels);
+    BlurTrace trace(info.width, info.height, radius, BlurEdgeMode::Rectangle);
+
+    // Cache entries hold RGBA8888 pixels
+    std::shared_ptr<BlurDiskCache> cache = format == PixelFormat::Rgba8888 ? diskCache() : nullptr;
+    uint64_t cacheKey = 0;
+    if (cache) {
+        std::unique_ptr<BlurDiskCache::Entry> entry;
+        {
+            BlurTrace::Stage stage(trace, BlurStage::CacheLookup);
+            uint64_t sourceHash = BlurDiskCache::hashPixels(bytes, info.width, info.height, info.stride);
+            cacheKey = BlurDiskCache::makeKey(sourceHash, info.width, info.height, radius, BlurEdgeMode::Rectangle);
+            entry = cache->lookup(cacheKey);
+        }
+        trace.setCacheOutcome(entry ? CacheOutcome::Hit : CacheOutcome::Miss);
+        if (entry) trace.setBackend(BlurBackend::DiskCache);
+
+        if (entry && entry->width() == static_cast<int>(info.width) &&
+            entry->height() == static_cast<int>(info.height)) {
+            entry->copyPixels(bytes, static_cast<int>(info.stride));
+            AndroidBitmap_unlockPixels(env, inputBitmap);
+            return inputBitmap;
+        }
+        if (entry) {
+            AndroidBitmap_unlockPixels(env, inputBitmap);
+            return createBitmapFromEntry(env, *entry);
+        }
+    }
+
+    if (format == PixelFormat::Rgba8888 &&
+        blurRectangleVulkan(bytes, info.width, info.height, info.stride, radius, trace)) {
+        if (cache) {
+            BlurTrace::Stage stage(trace, BlurStage::CacheStore);
+            cache->store(cacheKey, info.width, info.height, bytes, static_cast<int>(info.stride));
+        }
+        AndroidBitmap_unlockPixels(env, inputBitmap);
+        return inputBitmap;
+    }
+
+    // Full resolution results are read back in place, downscaled ones into a smaller bitmap
+    int downscale = calculateReadbackDownscale(radius);
+
+    // Downscaled readbacks are cheap enough on the GPU alone
+    if (hybridEnabled.load() && format == PixelFormat::Rgba8888 && downscale == 1 &&
+        info.stride == info.width * 4) {
+        trace.setBackend(BlurBackend::Hybrid);
+        renderThread().runSync([&] {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            hybridScheduler().render(bytes, info.width, info.height, radius, bytes);
+        });
+        if (cache) {
+            BlurTrace::Stage stage(trace, BlurStage::CacheStore);
+            cache->store(cacheKey, info.width, info.height, bytes, static_cast<int>(info.stride));
+        }
+        AndroidBitmap_unlockPixels(env, inputBitmap);
+        return inputBitmap;
+    }
+    if (format == PixelFormat::Rgba8888) {
+        jobject hardwareBitmap = blurRectangleZeroCopy(env, bytes, info.width, info.height, info.stride, radius,
+                                                       downscale, cache, cacheKey, trace);
+        if (hardwareBitmap) {
+            AndroidBitmap_unlockPixels(env, inputBitmap);
+            return hardwareBitmap;
+        }
+    }
+
+    int outputWidth = calculateDownscaledSize(info.width, downscale);
+    int outputHeight = calculateDownscaledSize(info.height, downscale);
+
+    jobject outputBitmap = inputBitmap;
+    unsigned char* outputBytes = bytes;
+    int outputStride = static_cast<int>(info.stride);
+    if (downscale > 1) {
+        outputBitmap = createBitmap(env, outputWidth, outputHeight, format);
+        outputBytes = lockOutputBitmap(env, outputBitmap, outputStride);
+        if (!outputBytes) {
+            AndroidBitmap_unlockPixels(env, inputBitmap);
+            return nullptr;
+        }
+    }
+
+    renderThread().runSync([&] {
+        BlurRenderer& renderer = rectangleRenderer();
+        int allocations = renderer.framebufferAllocations();
+
+        // GL calls only queue work, the GPU time mostly lands in the readback stage
+        GLuint texId;
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Upload);
+            texId = renderer.uploadBitmapAsTexture(bytes, info.width, info.height, format, info.stride);
+        }
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            renderer.render(texId, info.width, info.height, radius, downscale);
+        }
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Readback);
+            renderer.readFBO(outputBytes, renderer.outputWidth(), renderer.outputHeight(), format, outputStride);
+        }
+
+        glDeleteTextures(1, &texId);
+        trace.setPoolOutcome(renderer.framebufferAllocations() == allocations ? PoolOutcome::Reused
+                                                                               : PoolOutcome::Reallocated);
+    });
+
+    if (cache) {
+        BlurTrace::Stage stage(trace, BlurStage::CacheStore);
+        cache->store(cacheKey, outputWidth, outputHeight, outputBytes, outputStride);
+    }
+
+    AndroidBitmap_unlockPixels(env, inputBitmap);
+    if (outputBitmap != inputBitmap) {
+        AndroidBitmap_unlockPixels(env, outputBitmap);
+    }
+
+    return outputBitmap;
+}
 
 extern "C"
 JNIEXPORT jobject JNICALL
-Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmap(JNIEnv* env, jobject thiz,
-                                                        jobject inputBitmap, jfloat radius) {
-    // Keep the original rectangle blur implementation unchanged
+Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmapScrolled(JNIEnv* env, jobject thiz,
+                                                                jobject inputBitmap, jfloat radius,
+                                                                jlong frameKey, jint scrollX, jint scrollY) {
     AndroidBitmapInfo info;
     void* pixels;
+    PixelFormat format;
 
     if (AndroidBitmap_getInfo(env, inputBitmap, &info) < 0) {
         return nullptr;
     }
 
-    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+    if (!pixelFormatFromAndroid(info.format, format)) {
         return nullptr;
     }
 
@@ -27,21 +652,249 @@ Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmap(JNIEnv* env, jobject thi
         return nullptr;
     }
 
-    GLuint texId = rectangleRenderer.uploadBitmapAsTexture(reinterpret_cast<unsigned char*>(pixels),
-                                                           info.width, info.height);
+    BlurTrace trace(info.width, info.height, radius, BlurEdgeMode::Rectangle);
+    renderThread().runSync([&] {
+        BlurRenderer& renderer = rectangleRenderer();
+        int allocations = renderer.framebufferAllocations();
+
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(pixels);
+        GLuint texId;
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Upload);
+            texId = renderer.uploadBitmapAsTexture(bytes, info.width, info.height, format, info.stride);
+        }
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            renderer.renderScrolled(texId, info.width, info.height, radius, frameKey, scrollX, scrollY);
+        }
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Readback);
+            renderer.readFBO(bytes, info.width, info.height, format, info.stride);
+        }
 
-    rectangleRenderer.render(texId, info.width, info.height, radius);
-    rectangleRenderer.readFBO(reinterpret_cast<unsigned char*>(pixels), info.width, info.height);
+        glDeleteTextures(1, &texId);
+        trace.setPoolOutcome(renderer.framebufferAllocations() == allocations ? PoolOutcome::Reused
+                                                                               : PoolOutcome::Reallocated);
+    });
 
     AndroidBitmap_unlockPixels(env, inputBitmap);
 
     return inputBitmap;
 }
 
+// Returns a new bitmap holding the blur of inputBitmap grown by the blur padding.
+// GL work runs on the render thread, the bitmaps are handled with the caller's env.
+static jobject blurUnbounded(JNIEnv* env, jobject inputBitmap, float radius) {
+    AndroidBitmapInfo info;
+    void* pixels;
+    PixelFormat format;
+
+    if (AndroidBitmap_getInfo(env, inputBitmap, &info) < 0) {
+        return nullptr;
+    }
+
+    if (!pixelFormatFromAndroid(info.format, format)) {
+        return nullptr;
+    }
+
+    // The padding fades to transparent, which 565 can't hold
+    PixelFormat outputFormat = format == PixelFormat::Rgb565 ? PixelFormat::Rgba8888 : format;
+
+    if (AndroidBitmap_lockPixels(env, inputBitmap, &pixels) < 0) {
+        return nullptr;
+    }
+
+    BlurTrace trace(info.width, info.height, radius, BlurEdgeMode::Unbounded);
+
+    std::shared_ptr<BlurDiskCache> cache = format == PixelFormat::Rgba8888 ? diskCache() : nullptr;
+    uint64_t cacheKey = 0;
+    if (cache) {
+        std::unique_ptr<BlurDiskCache::Entry> entry;
+        {
+            BlurTrace::Stage stage(trace, BlurStage::CacheLookup);
+            uint64_t sourceHash = BlurDiskCache::hashPixels(reinterpret_cast<unsigned char*>(pixels),
+                                                            info.width, info.height, info.stride);
+            cacheKey = BlurDiskCache::makeKey(sourceHash, info.width, info.height, radius, BlurEdgeMode::Unbounded);
+            entry = cache->lookup(cacheKey);
+        }
+        trace.setCacheOutcome(entry ? CacheOutcome::Hit : CacheOutcome::Miss);
+
+        if (entry) {
+            trace.setBackend(BlurBackend::DiskCache);
+            AndroidBitmap_unlockPixels(env, inputBitmap);
+            return createBitmapFromEntry(env, *entry);
+        }
+    }
+
+    if (format == PixelFormat::Rgba8888) {
+        jobject vulkanBitmap = blurUnboundedVulkan(env, reinterpret_cast<unsigned char*>(pixels),
+                                                   info.width, info.height, info.stride, radius,
+                                                   cache, cacheKey, trace);
+        if (vulkanBitmap) {
+            AndroidBitmap_unlockPixels(env, inputBitmap);
+            return vulkanBitmap;
+        }
+    }
+
+    // The output size is known up front, so the bitmap is ready before the render thread starts.
+    // Upload, render and readback then run as one task, with no other blur (async ones included)
+    // getting onto the shared renderer in between.
+    int downscale = calculateReadbackDownscale(radius);
+    int outputWidth = calculateDownscaledSize(UnboundedBlurRenderer::calculateOutputSize(info.width, radius),
+                                              downscale);
+    int outputHeight = calculateDownscaledSize(UnboundedBlurRenderer::calculateOutputSize(info.height, radius),
+                                               downscale);
+    jobject outputBitmap = createBitmap(env, outputWidth, outputHeight, outputFormat);
+
+    int outputStride;
+    unsigned char* outputPixels = lockOutputBitmap(env, outputBitmap, outputStride);
+    if (!outputPixels) {
+        AndroidBitmap_unlockPixels(env, inputBitmap);
+        return nullptr;
+    }
+
+    renderThread().runSync([&] {
+        UnboundedBlurRenderer& renderer = unboundedRenderer();
+        int allocations = renderer.framebufferAllocations();
+        GLuint texId;
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Upload);
+            texId = renderer.uploadBitmapAsTexture(reinterpret_cast<unsigned char*>(pixels),
+                                                   info.width, info.height, format, info.stride);
+        }
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Render);
+            int renderedWidth, renderedHeight;
+            renderer.render(texId, info.width, info.height, radius, downscale, renderedWidth, renderedHeight);
+        }
+        {
+            BlurTrace::Stage stage(trace, BlurStage::Readback);
+            renderer.readFBO(outputPixels, outputWidth, outputHeight, outputFormat, outputStride);
+        }
+
+        glDeleteTextures(1, &texId);
+        trace.setPoolOutcome(renderer.framebufferAllocations() == allocations ? PoolOutcome::Reused
+                                                                               : PoolOutcome::Reallocated);
+    });
+
+    AndroidBitmap_unlockPixels(env, inputBitmap);
+
+    if (cache) {
+        BlurTrace::Stage stage(trace, BlurStage::CacheStore);
+        cache->store(cacheKey, outputWidth, outputHeight, outputPixels, outputStride);
+    }
+
+    AndroidBitmap_unlockPixels(env, outputBitmap);
+
+    return outputBitmap;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmap(JNIEnv* env, jobject thiz,
+                                                        jobject inputBitmap, jfloat radius) {
+    return blurRectangle(env, inputBitmap, radius);
+}
+
 extern "C"
 JNIEXPORT jobject JNICALL
 Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmapUnbounded(JNIEnv* env, jobject thiz,
                                                                  jobject inputBitmap, jfloat radius) {
+    return blurUnbounded(env, inputBitmap, radius);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_unboundedPadding(JNIEnv* env, jobject thiz, jfloat radius) {
+    return UnboundedBlurRenderer::calculatePadding(radius);
+}
+
+// Hands an async blur's outcome to its BlurCallback and releases the job's references
+static void finishAsyncBlur(JNIEnv* env, jobject bitmapRef, jobject callbackRef, jobject result,
+                            BlurJobOutcome outcome) {
+    jclass callbackClass = env->GetObjectClass(callbackRef);
+    jmethodID onBlurComplete = env->GetMethodID(callbackClass, "onBlurComplete",
+                                                "(Landroid/graphics/Bitmap;I)V");
+    env->CallVoidMethod(callbackRef, onBlurComplete, result, static_cast<jint>(outcome));
+    if (env->ExceptionCheck()) {
+        env->ExceptionClear();
+    }
+    env->DeleteLocalRef(callbackClass);
+
+    env->DeleteGlobalRef(bitmapRef);
+    env->DeleteGlobalRef(callbackRef);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmapAsync(JNIEnv* env, jobject thiz,
+                                                             jobject inputBitmap, jfloat radius,
+                                                             jint edgeTreatment, jlong surfaceId,
+                                                             jlong deadlineNanos, jobject callback) {
+    jobject bitmapRef = env->NewGlobalRef(inputBitmap);
+    jobject callbackRef = env->NewGlobalRef(callback);
+
+    BlurJob job;
+    job.surfaceId = surfaceId;
+    job.deadlineNanos = deadlineNanos;
+    job.run = [bitmapRef, callbackRef, radius, edgeTreatment] {
+        JNIEnv* threadEnv = renderThreadEnv();
+        if (!threadEnv) {
+            // Without an env neither the callback nor DeleteGlobalRef can be called
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Async blur dropped, no JNIEnv to report it");
+            return;
+        }
+
+        // Nothing returns to Java on this thread to free local references, so scope them explicitly
+        threadEnv->PushLocalFrame(16);
+
+        jobject result = nullptr;
+        try {
+            result = static_cast<BlurEdgeMode>(edgeTreatment) == BlurEdgeMode::Unbounded
+                     ? blurUnbounded(threadEnv, bitmapRef, radius)
+                     : blurRectangle(threadEnv, bitmapRef, radius);
+        } catch (const std::exception& e) {
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Async blur failed: %s", e.what());
+        } catch (...) {
+            // Whatever went wrong, the callback still has to hear back and the references be freed
+            __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Async blur failed");
+        }
+
+        finishAsyncBlur(threadEnv, bitmapRef, callbackRef, result,
+                        result ? BlurJobOutcome::Completed : BlurJobOutcome::Failed);
+        threadEnv->PopLocalFrame(nullptr);
+    };
+    job.discard = [bitmapRef, callbackRef](BlurJobOutcome outcome) {
+        JNIEnv* threadEnv = renderThreadEnv();
+        if (!threadEnv) {
+            __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, "Discarded async blur has no JNIEnv to report it");
+            return;
+        }
+        finishAsyncBlur(threadEnv, bitmapRef, callbackRef, nullptr, outcome);
+    };
+
+    blurScheduler().submit(std::move(job));
+}
+
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurNative_blurJobStats(JNIEnv* env, jobject thiz) {
+    BlurJobStats stats = blurScheduler().stats();
+    jlong values[] = {
+            static_cast<jlong>(stats.submitted),
+            static_cast<jlong>(stats.started),
+            static_cast<jlong>(stats.coalesced),
+            static_cast<jlong>(stats.expired),
+    };
+    jlongArray array = env->NewLongArray(4);
+    env->SetLongArrayRegion(array, 0, 4, values);
+    return array;
+}
+
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurCpu_blurBitmap(JNIEnv* env, jobject thiz,
+                                                     jobject inputBitmap, jfloat radius) {
     AndroidBitmapInfo info;
     void* pixels;
 
@@ -49,7 +902,7 @@ Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmapUnbounded(JNIEnv* env, jo
         return nullptr;
     }
 
-    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888) {
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 || info.stride != info.width * 4) {
         return nullptr;
     }
 
@@ -57,41 +910,102 @@ Java_io_sifr_shaded_blurProcessor_BlurNative_blurBitmapUnbounded(JNIEnv* env, jo
         return nullptr;
     }
 
-    // Upload input bitmap as texture
-    GLuint texId = unboundedRenderer.uploadBitmapAsTexture(reinterpret_cast<unsigned char*>(pixels),
-                                                           info.width, info.height);
-
-    // Calculate output dimensions
-    int outputWidth, outputHeight;
-    unboundedRenderer.render(texId, info.width, info.height, radius, outputWidth, outputHeight);
+    {
+        BlurTrace trace(info.width, info.height, radius, BlurEdgeMode::Rectangle);
+        trace.setBackend(BlurBackend::Cpu);
+        std::lock_guard<std::mutex> lock(cpuRendererMutex);
+        BlurTrace::Stage stage(trace, BlurStage::Render);
+        unsigned char* bytes = reinterpret_cast<unsigned char*>(pixels);
+        cpuRenderer().render(bytes, info.width, info.height, radius, bytes);
+    }
 
     AndroidBitmap_unlockPixels(env, inputBitmap);
 
-    // Create output bitmap with expanded dimensions
-    jclass bitmapClass = env->FindClass("android/graphics/Bitmap");
-    jmethodID createBitmapMethod = env->GetStaticMethodID(bitmapClass, "createBitmap",
-                                                          "(IILandroid/graphics/Bitmap$Config;)Landroid/graphics/Bitmap;");
+    return inputBitmap;
+}
 
-    jclass configClass = env->FindClass("android/graphics/Bitmap$Config");
-    jfieldID argb8888Field = env->GetStaticFieldID(configClass, "ARGB_8888", "Landroid/graphics/Bitmap$Config;");
-    jobject argb8888Config = env->GetStaticObjectField(configClass, argb8888Field);
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurCpu_blurBitmapUnbounded(JNIEnv* env, jobject thiz,
+                                                              jobject inputBitmap, jfloat radius) {
+    AndroidBitmapInfo info;
+    void* pixels;
 
-    jobject outputBitmap = env->CallStaticObjectMethod(bitmapClass, createBitmapMethod,
-                                                       outputWidth, outputHeight, argb8888Config);
+    if (AndroidBitmap_getInfo(env, inputBitmap, &info) < 0) {
+        return nullptr;
+    }
+
+    if (info.format != ANDROID_BITMAP_FORMAT_RGBA_8888 || info.stride != info.width * 4) {
+        return nullptr;
+    }
+
+    int padding = CpuBlurRenderer::calculatePadding(radius);
+    jobject outputBitmap = createArgb8888Bitmap(env, info.width + 2 * padding, info.height + 2 * padding);
 
-    // Lock output bitmap pixels
     void* outputPixels;
     if (AndroidBitmap_lockPixels(env, outputBitmap, &outputPixels) < 0) {
         return nullptr;
     }
 
-    // Read the blurred result
-    unboundedRenderer.readFBO(reinterpret_cast<unsigned char*>(outputPixels), outputWidth, outputHeight);
+    if (AndroidBitmap_lockPixels(env, inputBitmap, &pixels) < 0) {
+        AndroidBitmap_unlockPixels(env, outputBitmap);
+        return nullptr;
+    }
+
+    {
+        BlurTrace trace(info.width, info.height, radius, BlurEdgeMode::Unbounded);
+        trace.setBackend(BlurBackend::Cpu);
+        std::lock_guard<std::mutex> lock(cpuRendererMutex);
+        BlurTrace::Stage stage(trace, BlurStage::Render);
+        int outputWidth, outputHeight;
+        cpuRenderer().renderUnbounded(reinterpret_cast<unsigned char*>(pixels), info.width, info.height,
+                                      radius, reinterpret_cast<unsigned char*>(outputPixels),
+                                      outputWidth, outputHeight);
+    }
 
+    AndroidBitmap_unlockPixels(env, inputBitmap);
     AndroidBitmap_unlockPixels(env, outputBitmap);
 
-    // Clean up texture
-    glDeleteTextures(1, &texId);
-
     return outputBitmap;
-}
\ No newline at end of file
+}
+
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurCpu_blurRawFile(JNIEnv* env, jobject thiz, jstring inputPath,
+                                                      jint width, jint height, jfloat radius,
+                                                      jint edgeTreatment, jstring outputPath) {
+    const char* input = env->GetStringUTFChars(inputPath, nullptr);
+    const char* output = env->GetStringUTFChars(outputPath, nullptr);
+    BlurEdgeMode edgeMode = static_cast<BlurEdgeMode>(edgeTreatment);
+
+    bool success = true;
+    try {
+        BlurTrace trace(width, height, radius, edgeMode);
+        trace.setBackend(BlurBackend::Cpu);
+        BlurTrace::Stage stage(trace, BlurStage::Render);
+        // Own renderer, a long file blur shouldn't hold up bitmap blurs on the shared one
+        StreamingBlurRenderer renderer(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+        renderer.renderFile(input, width, height, radius, edgeMode, output);
+    } catch (const std::exception& e) {
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Raw file blur failed: %s", e.what());
+        success = false;
+    } catch (...) {
+        // Nothing may unwind into the JVM
+        __android_log_print(ANDROID_LOG_WARN, LOG_TAG, "Raw file blur failed");
+        success = false;
+    }
+
+    env->ReleaseStringUTFChars(inputPath, input);
+    env->ReleaseStringUTFChars(outputPath, output);
+    return success ? JNI_TRUE : JNI_FALSE;
+}
+
+extern "C"
+JNIEXPORT jstring JNICALL
+Java_io_sifr_shaded_blurProcessor_BlurCpu_benchmarkScaling(JNIEnv* env, jobject thiz,
+                                                           jint width, jint height, jfloat radius) {
+    int maxThreads = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::string report = CpuBlurRenderer::benchmarkScaling(width, height, radius, maxThreads);
+    __android_log_print(ANDROID_LOG_INFO, LOG_TAG, "%s", report.c_str());
+    return env->NewStringUTF(report.c_str());
+}
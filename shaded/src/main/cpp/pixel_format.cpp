@@ -0,0 +1,242 @@
+#include "pixel_format.h"
+#include <GLES2/gl2ext.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+    bool hasExtension(const char* name) {
+        const char* extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+        if (!extensions) return false;
+
+        size_t length = std::strlen(name);
+        for (const char* match = std::strstr(extensions, name); match; match = std::strstr(match + 1, name)) {
+            // Whole names only, GL_OES_texture_half_float is a prefix of its _linear sibling
+            bool startsToken = match == extensions || match[-1] == ' ';
+            bool endsToken = match[length] == ' ' || match[length] == '\0';
+            if (startsToken && endsToken) return true;
+        }
+        return false;
+    }
+
+    float halfToFloat(uint16_t half) {
+        int exponent = (half >> 10) & 0x1f;
+        int mantissa = half & 0x3ff;
+        float sign = (half & 0x8000) ? -1.0f : 1.0f;
+
+        if (exponent == 0) return sign * std::ldexp(static_cast<float>(mantissa), -24);
+        if (exponent == 31) return mantissa ? NAN : sign * INFINITY;
+        return sign * std::ldexp(static_cast<float>(mantissa | 0x400), exponent - 25);
+    }
+
+    // Only used for values in [0, 1], so no overflow or NaN handling
+    uint16_t floatToHalf(float value) {
+        if (value <= 0.0f) return 0;
+
+        int exponent;
+        float mantissa = std::frexp(value, &exponent); // value = mantissa * 2^exponent, mantissa in [0.5, 1)
+        int halfExponent = exponent + 14;
+
+        if (halfExponent <= 0) {
+            return static_cast<uint16_t>(std::lround(std::ldexp(value, 24)));
+        }
+
+        int halfMantissa = static_cast<int>(std::lround(mantissa * 2048.0f)) - 1024;
+        if (halfMantissa == 1024) {
+            halfMantissa = 0;
+            ++halfExponent;
+        }
+        return static_cast<uint16_t>((halfExponent << 10) | halfMantissa);
+    }
+
+    unsigned char toByte(float value) {
+        if (!(value > 0.0f)) return 0;
+        if (value >= 1.0f) return 255;
+        return static_cast<unsigned char>(value * 255.0f + 0.5f);
+    }
+
+    // Staging copies up to this size stay allocated for the next call, larger ones are freed
+    // once done with, so one huge bitmap doesn't pin its size for the life of the process
+    constexpr size_t kRetainedStagingBytes = 4 * 1024 * 1024;
+
+    // RGBA8888 copy of pixels on their way to or from GL. Only used on the render thread.
+    class StagingBuffer {
+    public:
+        explicit StagingBuffer(size_t size) : buffer_(storage()) {
+            if (buffer_.size() < size) buffer_.resize(size);
+        }
+
+        ~StagingBuffer() {
+            if (buffer_.size() > kRetainedStagingBytes) std::vector<unsigned char>().swap(buffer_);
+        }
+
+        StagingBuffer(const StagingBuffer&) = delete;
+        StagingBuffer& operator=(const StagingBuffer&) = delete;
+
+        unsigned char* data() { return buffer_.data(); }
+
+    private:
+        static std::vector<unsigned char>& storage() {
+            static std::vector<unsigned char> buffer;
+            return buffer;
+        }
+
+        std::vector<unsigned char>& buffer_;
+    };
+}
+
+int bytesPerPixel(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Rgb565: return 2;
+        case PixelFormat::Alpha8: return 1;
+        case PixelFormat::RgbaF16: return 8;
+        case PixelFormat::Rgba8888:
+        default: return 4;
+    }
+}
+
+GLenum glFormatFor(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Rgb565: return GL_RGB;
+        case PixelFormat::Alpha8: return GL_ALPHA;
+        case PixelFormat::RgbaF16:
+        case PixelFormat::Rgba8888:
+        default: return GL_RGBA;
+    }
+}
+
+GLenum glTypeFor(PixelFormat format) {
+    switch (format) {
+        case PixelFormat::Rgb565: return GL_UNSIGNED_SHORT_5_6_5;
+        case PixelFormat::RgbaF16: return GL_HALF_FLOAT_OES;
+        case PixelFormat::Alpha8:
+        case PixelFormat::Rgba8888:
+        default: return GL_UNSIGNED_BYTE;
+    }
+}
+
+bool canUploadDirectly(PixelFormat format) {
+    if (format != PixelFormat::RgbaF16) return true;
+    return hasExtension("GL_OES_texture_half_float") && hasExtension("GL_OES_texture_half_float_linear");
+}
+
+bool canReadDirectly(PixelFormat format) {
+    if (format == PixelFormat::Rgba8888) return true;
+
+    GLint readFormat = 0;
+    GLint readType = 0;
+    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_FORMAT, &readFormat);
+    glGetIntegerv(GL_IMPLEMENTATION_COLOR_READ_TYPE, &readType);
+    return static_cast<GLenum>(readFormat) == glFormatFor(format) &&
+           static_cast<GLenum>(readType) == glTypeFor(format);
+}
+
+int alignmentForStride(int width, PixelFormat format, int stride) {
+    int rowBytes = width * bytesPerPixel(format);
+    for (int alignment = 1; alignment <= 8; alignment *= 2) {
+        if (stride == (rowBytes + alignment - 1) / alignment * alignment) return alignment;
+    }
+    return 0;
+}
+
+void convertToRgba8888(const unsigned char* pixels, int width, int height, PixelFormat format,
+                       int stride, unsigned char* rgba) {
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* row = pixels + static_cast<size_t>(y) * stride;
+        unsigned char* target = rgba + static_cast<size_t>(y) * width * 4;
+
+        for (int x = 0; x < width; ++x, target += 4) {
+            switch (format) {
+                case PixelFormat::Rgb565: {
+                    uint16_t pixel;
+                    std::memcpy(&pixel, row + x * 2, sizeof(pixel));
+                    target[0] = static_cast<unsigned char>(((pixel >> 11) & 0x1f) * 255 / 31);
+                    target[1] = static_cast<unsigned char>(((pixel >> 5) & 0x3f) * 255 / 63);
+                    target[2] = static_cast<unsigned char>((pixel & 0x1f) * 255 / 31);
+                    target[3] = 255;
+                    break;
+                }
+                case PixelFormat::Alpha8:
+                    target[0] = target[1] = target[2] = 0;
+                    target[3] = row[x];
+                    break;
+                case PixelFormat::RgbaF16:
+                    for (int c = 0; c < 4; ++c) {
+                        uint16_t half;
+                        std::memcpy(&half, row + x * 8 + c * 2, sizeof(half));
+                        target[c] = toByte(halfToFloat(half));
+                    }
+                    break;
+                case PixelFormat::Rgba8888:
+                    std::memcpy(target, row + x * 4, 4);
+                    break;
+            }
+        }
+    }
+}
+
+void packFromRgba8888(const unsigned char* rgba, int width, int height, PixelFormat format,
+                      int stride, unsigned char* pixels) {
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* source = rgba + static_cast<size_t>(y) * width * 4;
+        unsigned char* row = pixels + static_cast<size_t>(y) * stride;
+
+        for (int x = 0; x < width; ++x, source += 4) {
+            switch (format) {
+                case PixelFormat::Rgb565: {
+                    uint16_t pixel = static_cast<uint16_t>(((source[0] * 31 + 127) / 255) << 11 |
+                                                           ((source[1] * 63 + 127) / 255) << 5 |
+                                                           ((source[2] * 31 + 127) / 255));
+                    std::memcpy(row + x * 2, &pixel, sizeof(pixel));
+                    break;
+                }
+                case PixelFormat::Alpha8:
+                    row[x] = source[3];
+                    break;
+                case PixelFormat::RgbaF16:
+                    for (int c = 0; c < 4; ++c) {
+                        uint16_t half = floatToHalf(source[c] / 255.0f);
+                        std::memcpy(row + x * 8 + c * 2, &half, sizeof(half));
+                    }
+                    break;
+                case PixelFormat::Rgba8888:
+                    std::memcpy(row + x * 4, source, 4);
+                    break;
+            }
+        }
+    }
+}
+
+void uploadPixels(const unsigned char* pixels, int width, int height, PixelFormat format, int stride) {
+    int alignment = alignmentForStride(width, format, stride);
+
+    // Alignment is set on every call instead of being restored, the staging copy is tightly packed
+    if (alignment != 0 && canUploadDirectly(format)) {
+        GLenum glFormat = glFormatFor(format);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+        glTexImage2D(GL_TEXTURE_2D, 0, glFormat, width, height, 0, glFormat, glTypeFor(format), pixels);
+        return;
+    }
+
+    StagingBuffer rgba(static_cast<size_t>(width) * height * 4);
+    convertToRgba8888(pixels, width, height, format, stride, rgba.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+}
+
+void readPixels(unsigned char* pixels, int width, int height, PixelFormat format, int stride) {
+    int alignment = alignmentForStride(width, format, stride);
+
+    if (alignment != 0 && canReadDirectly(format)) {
+        glPixelStorei(GL_PACK_ALIGNMENT, alignment);
+        glReadPixels(0, 0, width, height, glFormatFor(format), glTypeFor(format), pixels);
+        return;
+    }
+
+    // RGBA / UNSIGNED_BYTE readback always works, and is packed into format on the CPU
+    StagingBuffer rgba(static_cast<size_t>(width) * height * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+    packFromRgba8888(rgba.data(), width, height, format, stride, pixels);
+}
@@ -0,0 +1,48 @@
+#ifndef PIXEL_FORMAT_H
+#define PIXEL_FORMAT_H
+
+#include <GLES2/gl2.h>
+
+// Bitmap formats the renderers take as is. Uploads use the matching GL format and type, so
+// 565 and alpha-only content moves half or a quarter of the bytes RGBA8888 would.
+enum class PixelFormat {
+    Rgba8888,
+    Rgb565,
+    Alpha8,
+    RgbaF16
+};
+
+int bytesPerPixel(PixelFormat format);
+GLenum glFormatFor(PixelFormat format);
+GLenum glTypeFor(PixelFormat format);
+
+// Whether the current GL context can sample textures of this format with linear filtering.
+// Half float needs OES_texture_half_float(_linear), everything else is core GLES2.
+bool canUploadDirectly(PixelFormat format);
+
+// Whether glReadPixels of the bound framebuffer can write this format as is. GLES2 always reads
+// RGBA8888, plus the one format and type the implementation prefers for the framebuffer, often
+// 565 for RGB targets.
+bool canReadDirectly(PixelFormat format);
+
+// GL_UNPACK_ALIGNMENT / GL_PACK_ALIGNMENT matching a row stride, or 0 if GLES2 can't express it
+int alignmentForStride(int width, PixelFormat format, int stride);
+
+// Expands pixels GL can't sample directly into tightly packed RGBA8888
+void convertToRgba8888(const unsigned char* pixels, int width, int height, PixelFormat format,
+                       int stride, unsigned char* rgba);
+
+// glTexImage2D of a bitmap's pixels into the bound texture. Formats or strides GL can't take
+// directly go through an RGBA8888 staging copy.
+void uploadPixels(const unsigned char* pixels, int width, int height, PixelFormat format, int stride);
+
+// glReadPixels of the bound framebuffer into a bitmap of the given format and stride. Formats or
+// strides GL can't write directly go through an RGBA8888 staging copy.
+void readPixels(unsigned char* pixels, int width, int height, PixelFormat format, int stride);
+
+// Packs tightly packed RGBA8888 readback into the given format. Alpha8 keeps the alpha channel.
+// Float output carries the 8 bit precision of the framebuffer.
+void packFromRgba8888(const unsigned char* rgba, int width, int height, PixelFormat format,
+                      int stride, unsigned char* pixels);
+
+#endif // PIXEL_FORMAT_H
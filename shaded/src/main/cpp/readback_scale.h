@@ -0,0 +1,17 @@
+#ifndef READBACK_SCALE_H
+#define READBACK_SCALE_H
+
+// A blurred image carries almost no high frequency detail, so for larger radii the final pass
+// renders into a smaller framebuffer and the result is scaled up again when drawn. That shrinks
+// glReadPixels and the output bitmap by up to 16x.
+inline int calculateReadbackDownscale(float radius) {
+    if (radius >= 16.0f) return 4;
+    if (radius >= 8.0f) return 2;
+    return 1;
+}
+
+inline int calculateDownscaledSize(int size, int downscale) {
+    return (size + downscale - 1) / downscale;
+}
+
+#endif // READBACK_SCALE_H
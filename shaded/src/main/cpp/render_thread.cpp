@@ -0,0 +1,74 @@
+#include "render_thread.h"
+#include <exception>
+
+RenderThread::RenderThread() : stopping_(false), thread_(&RenderThread::loop, this) {}
+
+RenderThread::~RenderThread() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void RenderThread::post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(task));
+    }
+    condition_.notify_one();
+}
+
+void RenderThread::runSync(const std::function<void()>& task) {
+    if (isCurrent()) {
+        task();
+        return;
+    }
+
+    std::mutex doneMutex;
+    std::condition_variable doneCondition;
+    bool done = false;
+    std::exception_ptr error;
+
+    post([&] {
+        try {
+            task();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        std::lock_guard<std::mutex> lock(doneMutex);
+        done = true;
+        doneCondition.notify_one();
+    });
+
+    std::unique_lock<std::mutex> lock(doneMutex);
+    doneCondition.wait(lock, [&] { return done; });
+
+    if (error) std::rethrow_exception(error);
+}
+
+bool RenderThread::isCurrent() const {
+    return std::this_thread::get_id() == thread_.get_id();
+}
+
+void RenderThread::loop() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+            if (tasks_.empty()) return;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        try {
+            task();
+        } catch (...) {
+            // Posted tasks report their own failures, keep the thread alive for the next one
+        }
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Single thread that owns the EGL contexts. An EGL context can only be current on one thread
+// at a time, so all GL work is funneled through here, whether the caller waits for it or not.
+class RenderThread {
+public:
+    RenderThread();
+    ~RenderThread();
+
+    RenderThread(const RenderThread&) = delete;
+    RenderThread& operator=(const RenderThread&) = delete;
+
+    // Queues a task and returns immediately. Tasks must handle their own errors.
+    void post(std::function<void()> task);
+
+    // Runs a task and waits for it, rethrowing anything it throws.
+    // Runs inline when already called from the render thread.
+    void runSync(const std::function<void()>& task);
+
+    bool isCurrent() const;
+
+private:
+    void loop();
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<std::function<void()>> tasks_;
+    bool stopping_;
+
+    std::thread thread_;
+};
+
+#endif // RENDER_THREAD_H
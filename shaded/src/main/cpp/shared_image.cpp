@@ -0,0 +1,291 @@
+#include "shared_image.h"
+#include <GLES2/gl2ext.h>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dlfcn.h>
+#include <mutex>
+#ifndef __ANDROID__
+#include <fcntl.h>
+#include <linux/dma-buf.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    bool hasExtension(const char* extensions, const char* name) {
+        if (!extensions) return false;
+        size_t length = std::strlen(name);
+        for (const char* at = std::strstr(extensions, name); at; at = std::strstr(at + length, name)) {
+            bool starts = at == extensions || at[-1] == ' ';
+            bool ends = at[length] == ' ' || at[length] == '\0';
+            if (starts && ends) return true;
+        }
+        return false;
+    }
+
+    // EGLImage entry points are extensions, looked up once through eglGetProcAddress
+    struct ImageFunctions {
+        PFNEGLCREATEIMAGEKHRPROC createImage = nullptr;
+        PFNEGLDESTROYIMAGEKHRPROC destroyImage = nullptr;
+        PFNGLEGLIMAGETARGETTEXTURE2DOESPROC imageTargetTexture = nullptr;
+#ifdef __ANDROID__
+        PFNEGLGETNATIVECLIENTBUFFERANDROIDPROC nativeClientBuffer = nullptr;
+#endif
+    };
+
+    const ImageFunctions& imageFunctions() {
+        static ImageFunctions functions;
+        static std::once_flag loaded;
+        std::call_once(loaded, [] {
+            functions.createImage = reinterpret_cast<PFNEGLCREATEIMAGEKHRPROC>(
+                    eglGetProcAddress("eglCreateImageKHR"));
+            functions.destroyImage = reinterpret_cast<PFNEGLDESTROYIMAGEKHRPROC>(
+                    eglGetProcAddress("eglDestroyImageKHR"));
+            functions.imageTargetTexture = reinterpret_cast<PFNGLEGLIMAGETARGETTEXTURE2DOESPROC>(
+                    eglGetProcAddress("glEGLImageTargetTexture2DOES"));
+#ifdef __ANDROID__
+            functions.nativeClientBuffer = reinterpret_cast<PFNEGLGETNATIVECLIENTBUFFERANDROIDPROC>(
+                    eglGetProcAddress("eglGetNativeClientBufferANDROID"));
+#endif
+        });
+        return functions;
+    }
+
+#ifdef __ANDROID__
+    // AHardwareBuffer arrived in API 26, above minSdk, so it's resolved from libandroid at runtime
+    struct HardwareBufferFunctions {
+        int (*allocate)(const AHardwareBuffer_Desc*, AHardwareBuffer**) = nullptr;
+        void (*release)(AHardwareBuffer*) = nullptr;
+        void (*describe)(const AHardwareBuffer*, AHardwareBuffer_Desc*) = nullptr;
+        int (*lock)(AHardwareBuffer*, uint64_t, int32_t, const ARect*, void**) = nullptr;
+        int (*unlock)(AHardwareBuffer*, int32_t*) = nullptr;
+
+        bool loaded() const { return allocate && release && describe && lock && unlock; }
+    };
+
+    const HardwareBufferFunctions& hardwareBufferFunctions() {
+        static HardwareBufferFunctions functions;
+        static std::once_flag loaded;
+        std::call_once(loaded, [] {
+            void* library = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+            if (!library) return;
+            functions.allocate = reinterpret_cast<decltype(functions.allocate)>(
+                    dlsym(library, "AHardwareBuffer_allocate"));
+            functions.release = reinterpret_cast<decltype(functions.release)>(
+                    dlsym(library, "AHardwareBuffer_release"));
+            functions.describe = reinterpret_cast<decltype(functions.describe)>(
+                    dlsym(library, "AHardwareBuffer_describe"));
+            functions.lock = reinterpret_cast<decltype(functions.lock)>(dlsym(library, "AHardwareBuffer_lock"));
+            functions.unlock = reinterpret_cast<decltype(functions.unlock)>(dlsym(library, "AHardwareBuffer_unlock"));
+        });
+        return functions;
+    }
+#else
+    // DRM_FORMAT_ABGR8888, bytes R G B A in memory like the rest of the renderers use
+    constexpr uint32_t kFormatAbgr8888 = 0x34324241;
+    constexpr uint32_t kGbmUseRendering = 1 << 2;
+    constexpr uint32_t kGbmUseLinear = 1 << 4;
+
+    // libgbm and its render node are optional on hosts, both are opened once on first use
+    struct Gbm {
+        struct gbm_device* (*createDevice)(int) = nullptr;
+        struct gbm_bo* (*createBufferObject)(struct gbm_device*, uint32_t, uint32_t, uint32_t, uint32_t) = nullptr;
+        void (*destroyBufferObject)(struct gbm_bo*) = nullptr;
+        int (*bufferObjectFd)(struct gbm_bo*) = nullptr;
+        uint32_t (*bufferObjectStride)(struct gbm_bo*) = nullptr;
+
+        int renderNode = -1;
+        struct gbm_device* device = nullptr;
+    };
+
+    const Gbm& gbm() {
+        static Gbm gbm;
+        static std::once_flag opened;
+        std::call_once(opened, [] {
+            void* library = dlopen("libgbm.so.1", RTLD_NOW | RTLD_LOCAL);
+            if (!library) return;
+            gbm.createDevice = reinterpret_cast<decltype(gbm.createDevice)>(dlsym(library, "gbm_create_device"));
+            gbm.createBufferObject = reinterpret_cast<decltype(gbm.createBufferObject)>(
+                    dlsym(library, "gbm_bo_create"));
+            gbm.destroyBufferObject = reinterpret_cast<decltype(gbm.destroyBufferObject)>(
+                    dlsym(library, "gbm_bo_destroy"));
+            gbm.bufferObjectFd = reinterpret_cast<decltype(gbm.bufferObjectFd)>(dlsym(library, "gbm_bo_get_fd"));
+            gbm.bufferObjectStride = reinterpret_cast<decltype(gbm.bufferObjectStride)>(
+                    dlsym(library, "gbm_bo_get_stride"));
+            if (!gbm.createDevice || !gbm.createBufferObject || !gbm.destroyBufferObject ||
+                !gbm.bufferObjectFd || !gbm.bufferObjectStride) {
+                return;
+            }
+
+            for (int node = 128; node < 136 && !gbm.device; ++node) {
+                char path[32];
+                std::snprintf(path, sizeof(path), "/dev/dri/renderD%d", node);
+                gbm.renderNode = open(path, O_RDWR | O_CLOEXEC);
+                if (gbm.renderNode < 0) continue;
+                gbm.device = gbm.createDevice(gbm.renderNode);
+                if (!gbm.device) {
+                    close(gbm.renderNode);
+                    gbm.renderNode = -1;
+                }
+            }
+        });
+        return gbm;
+    }
+
+    void syncDmaBuf(int fd, uint64_t flags) {
+        dma_buf_sync sync{flags};
+        ioctl(fd, DMA_BUF_IOCTL_SYNC, &sync);
+    }
+#endif
+}
+
+SharedImage::SharedImage(int width, int height)
+        : width_(width), height_(height), display_(eglGetCurrentDisplay()), image_(EGL_NO_IMAGE_KHR),
+          texture_(0), framebuffer_(0),
+#ifdef __ANDROID__
+          buffer_(nullptr) {}
+#else
+          bufferObject_(nullptr), bufferFd_(-1), stride_(0), mapping_(nullptr), mappingSize_(0) {}
+#endif
+
+std::unique_ptr<SharedImage> SharedImage::create(int width, int height) {
+    const ImageFunctions& functions = imageFunctions();
+    if (!functions.createImage || !functions.destroyImage || !functions.imageTargetTexture) return nullptr;
+    if (!hasExtension(reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS)), "GL_OES_EGL_image")) {
+        return nullptr;
+    }
+
+    std::unique_ptr<SharedImage> image(new SharedImage(width, height));
+    if (image->display_ == EGL_NO_DISPLAY || !image->allocate() || !image->attach()) return nullptr;
+    return image;
+}
+
+SharedImage::~SharedImage() {
+    if (framebuffer_) glDeleteFramebuffers(1, &framebuffer_);
+    if (texture_) glDeleteTextures(1, &texture_);
+    if (image_ != EGL_NO_IMAGE_KHR) imageFunctions().destroyImage(display_, image_);
+#ifdef __ANDROID__
+    if (buffer_) hardwareBufferFunctions().release(buffer_);
+#else
+    if (mapping_) munmap(mapping_, mappingSize_);
+    if (bufferFd_ >= 0) close(bufferFd_);
+    if (bufferObject_) gbm().destroyBufferObject(bufferObject_);
+#endif
+}
+
+#ifdef __ANDROID__
+bool SharedImage::allocate() {
+    const HardwareBufferFunctions& buffers = hardwareBufferFunctions();
+    const ImageFunctions& functions = imageFunctions();
+    if (!buffers.loaded() || !functions.nativeClientBuffer ||
+        !hasExtension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_ANDROID_image_native_buffer")) {
+        return false;
+    }
+
+    // Sampled for hardware bitmaps, read rarely by the CPU for the disk cache
+    AHardwareBuffer_Desc description = {};
+    description.width = static_cast<uint32_t>(width_);
+    description.height = static_cast<uint32_t>(height_);
+    description.layers = 1;
+    description.format = AHARDWAREBUFFER_FORMAT_R8G8B8A8_UNORM;
+    description.usage = AHARDWAREBUFFER_USAGE_GPU_COLOR_OUTPUT | AHARDWAREBUFFER_USAGE_GPU_SAMPLED_IMAGE |
+                        AHARDWAREBUFFER_USAGE_CPU_READ_RARELY;
+    if (buffers.allocate(&description, &buffer_) != 0) {
+        buffer_ = nullptr;
+        return false;
+    }
+
+    const EGLint attributes[] = {EGL_IMAGE_PRESERVED_KHR, EGL_TRUE, EGL_NONE};
+    image_ = functions.createImage(display_, EGL_NO_CONTEXT, EGL_NATIVE_BUFFER_ANDROID,
+                                   functions.nativeClientBuffer(buffer_), attributes);
+    return image_ != EGL_NO_IMAGE_KHR;
+}
+
+const unsigned char* SharedImage::lock(int& stride) {
+    const HardwareBufferFunctions& buffers = hardwareBufferFunctions();
+    AHardwareBuffer_Desc description;
+    buffers.describe(buffer_, &description);
+    stride = static_cast<int>(description.stride) * 4;
+
+    void* address = nullptr;
+    if (buffers.lock(buffer_, AHARDWAREBUFFER_USAGE_CPU_READ_RARELY, -1, nullptr, &address) != 0) return nullptr;
+    return static_cast<const unsigned char*>(address);
+}
+
+void SharedImage::unlock() {
+    hardwareBufferFunctions().unlock(buffer_, nullptr);
+}
+#else
+bool SharedImage::allocate() {
+    const Gbm& device = gbm();
+    if (!device.device || !hasExtension(eglQueryString(display_, EGL_EXTENSIONS), "EGL_EXT_image_dma_buf_import")) {
+        return false;
+    }
+
+    // Linear so the CPU mapping is plain rows
+    bufferObject_ = device.createBufferObject(device.device, static_cast<uint32_t>(width_),
+                                              static_cast<uint32_t>(height_), kFormatAbgr8888,
+                                              kGbmUseRendering | kGbmUseLinear);
+    if (!bufferObject_) return false;
+    bufferFd_ = device.bufferObjectFd(bufferObject_);
+    stride_ = static_cast<int>(device.bufferObjectStride(bufferObject_));
+    if (bufferFd_ < 0) return false;
+
+    const EGLint attributes[] = {
+            EGL_WIDTH, width_,
+            EGL_HEIGHT, height_,
+            EGL_LINUX_DRM_FOURCC_EXT, static_cast<EGLint>(kFormatAbgr8888),
+            EGL_DMA_BUF_PLANE0_FD_EXT, bufferFd_,
+            EGL_DMA_BUF_PLANE0_OFFSET_EXT, 0,
+            EGL_DMA_BUF_PLANE0_PITCH_EXT, stride_,
+            EGL_NONE
+    };
+    image_ = imageFunctions().createImage(display_, EGL_NO_CONTEXT, EGL_LINUX_DMA_BUF_EXT, nullptr, attributes);
+    return image_ != EGL_NO_IMAGE_KHR;
+}
+
+const unsigned char* SharedImage::lock(int& stride) {
+    if (!mapping_) {
+        mappingSize_ = static_cast<size_t>(stride_) * height_;
+        void* mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_SHARED, bufferFd_, 0);
+        if (mapping == MAP_FAILED) return nullptr;
+        mapping_ = mapping;
+    }
+    syncDmaBuf(bufferFd_, DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ);
+    stride = stride_;
+    return static_cast<const unsigned char*>(mapping_);
+}
+
+void SharedImage::unlock() {
+    syncDmaBuf(bufferFd_, DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ);
+}
+#endif
+
+bool SharedImage::attach() {
+    // Only errors raised by the import below count
+    while (glGetError() != GL_NO_ERROR) {}
+
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    imageFunctions().imageTargetTexture(GL_TEXTURE_2D, static_cast<GLeglImageOES>(image_));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (glGetError() != GL_NO_ERROR) return false;
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void SharedImage::finishRendering() {
+    // Nothing else orders the GPU writes before the CPU or the compositor read the buffer.
+    // glReadPixels waited just as long, without the copy.
+    glFinish();
+}
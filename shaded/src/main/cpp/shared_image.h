@@ -0,0 +1,67 @@
+#ifndef SHARED_IMAGE_H
+#define SHARED_IMAGE_H
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <GLES2/gl2.h>
+#include <cstddef>
+#include <memory>
+#ifdef __ANDROID__
+#include <android/hardware_buffer.h>
+#endif
+
+// An RGBA8888 render target whose pixels live in a buffer shared with the CPU and other processes,
+// imported into GL as an EGLImage: an AHardwareBuffer on Android, a linear GBM dma-buf through
+// EGL_EXT_image_dma_buf_import on Linux hosts. A blur whose final pass renders into one can be
+// mapped or handed out as is, instead of being copied out with glReadPixels.
+//
+// Created, rendered into and destroyed on a thread with a GL context current. The buffer
+// functions are looked up at runtime, they are newer than minSdk on Android and optional on hosts.
+class SharedImage {
+public:
+    // Null when the platform, driver or EGL can't share buffers with GL
+    static std::unique_ptr<SharedImage> create(int width, int height);
+    ~SharedImage();
+
+    SharedImage(const SharedImage&) = delete;
+    SharedImage& operator=(const SharedImage&) = delete;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    GLuint framebuffer() const { return framebuffer_; }
+
+    // Waits for the GPU to finish rendering, before the pixels are read or handed out
+    void finishRendering();
+
+    // Maps the pixels for reading, rows are stride bytes apart. Null if mapping failed.
+    const unsigned char* lock(int& stride);
+    void unlock();
+
+#ifdef __ANDROID__
+    AHardwareBuffer* hardwareBuffer() const { return buffer_; }
+#endif
+
+private:
+    SharedImage(int width, int height);
+
+    bool allocate();
+    bool attach();
+
+    int width_;
+    int height_;
+    EGLDisplay display_;
+    EGLImageKHR image_;
+    GLuint texture_;
+    GLuint framebuffer_;
+#ifdef __ANDROID__
+    AHardwareBuffer* buffer_;
+#else
+    struct gbm_bo* bufferObject_;
+    int bufferFd_;
+    int stride_;
+    void* mapping_;
+    size_t mappingSize_;
+#endif
+};
+
+#endif // SHARED_IMAGE_H
@@ -0,0 +1,27 @@
+#ifndef SMALL_KERNEL_H
+#define SMALL_KERNEL_H
+
+#include <cmath>
+
+// Up to this radius the kernel has at most 5 taps per axis, so a single 2D pass straight into the
+// output framebuffer is cheaper than two passes through the full size intermediate texture.
+constexpr float kSinglePassMaxRadius = 2.0f;
+
+// Normalized 1D weights at offsets 0, 1 and 2, same kernel as the two-pass shaders
+// (sigma = radius / 2, taps with |x| <= radius)
+inline void calculateSmallKernelWeights(float radius, float weights[3]) {
+    float sigma = radius / 2.0f;
+    float twoSigmaSq = 2.0f * sigma * sigma;
+
+    float totalWeight = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+        weights[i] = static_cast<float>(i) <= radius ? std::exp(-static_cast<float>(i * i) / twoSigmaSq) : 0.0f;
+        totalWeight += i == 0 ? weights[i] : 2.0f * weights[i];
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        weights[i] /= totalWeight;
+    }
+}
+
+#endif // SMALL_KERNEL_H
@@ -0,0 +1,264 @@
+#include "streaming_blur.h"
+#include "cpu_blur.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    // Same column tiles as the CPU renderer's vertical pass
+    constexpr int kTileWidth = 64;
+
+    // Mapped input pages behind the rows already read are released in steps of this many bytes
+    constexpr size_t kReleaseStep = 4 * 1024 * 1024;
+
+    inline unsigned char toByte(float value) {
+        return static_cast<unsigned char>(std::min(255.0f, value + 0.5f));
+    }
+
+    std::runtime_error fileError(const char* what, const std::string& path) {
+        return std::runtime_error(std::string(what) + " " + path + ": " + std::strerror(errno));
+    }
+
+    // Read-only mapping of a whole file
+    class MappedFile {
+    public:
+        MappedFile(const std::string& path, size_t expectedSize) : data_(nullptr), size_(0) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) throw fileError("Failed to open", path);
+
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                close(fd);
+                throw fileError("Failed to stat", path);
+            }
+            if (static_cast<size_t>(info.st_size) != expectedSize) {
+                close(fd);
+                throw std::runtime_error("Unexpected size of " + path + ": " + std::to_string(info.st_size) +
+                                         " bytes instead of " + std::to_string(expectedSize));
+            }
+
+            void* data = mmap(nullptr, expectedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (data == MAP_FAILED) throw fileError("Failed to map", path);
+
+            data_ = static_cast<const unsigned char*>(data);
+            size_ = expectedSize;
+            madvise(const_cast<unsigned char*>(data_), size_, MADV_SEQUENTIAL);
+        }
+
+        ~MappedFile() {
+            munmap(const_cast<unsigned char*>(data_), size_);
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        const unsigned char* data() const { return data_; }
+
+        // Drops the pages before offset from memory, reading them again would fault them back in
+        void release(size_t offset) {
+            size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+            size_t end = offset / pageSize * pageSize;
+            madvise(const_cast<unsigned char*>(data_), end, MADV_DONTNEED);
+        }
+
+    private:
+        const unsigned char* data_;
+        size_t size_;
+    };
+
+    class OutputFile {
+    public:
+        explicit OutputFile(const std::string& path) : path_(path), file_(std::fopen(path.c_str(), "wb")) {
+            if (!file_) throw fileError("Failed to create", path);
+        }
+
+        ~OutputFile() {
+            if (file_) std::fclose(file_);
+        }
+
+        OutputFile(const OutputFile&) = delete;
+        OutputFile& operator=(const OutputFile&) = delete;
+
+        void write(const unsigned char* data, size_t size) {
+            if (std::fwrite(data, 1, size, file_) != size) throw fileError("Failed to write", path_);
+        }
+
+        void close() {
+            int result = std::fclose(file_);
+            file_ = nullptr;
+            if (result != 0) throw fileError("Failed to write", path_);
+        }
+
+    private:
+        std::string path_;
+        FILE* file_;
+    };
+}
+
+StreamingBlurRenderer::StreamingBlurRenderer(int threadCount)
+        : pool_(threadCount), kernelRadius_(0), ringRows_(0) {}
+
+int StreamingBlurRenderer::calculatePadding(float radius, BlurEdgeMode edgeMode) {
+    return edgeMode == BlurEdgeMode::Unbounded ? CpuBlurRenderer::calculatePadding(radius) : 0;
+}
+
+size_t StreamingBlurRenderer::bufferBytes() const {
+    return inputBand_.size() + ring_.size() + outputBand_.size();
+}
+
+unsigned char* StreamingBlurRenderer::ringRow(int inputRow, int outputWidth) {
+    return ring_.data() + static_cast<size_t>(inputRow % ringRows_) * outputWidth * 4;
+}
+
+void StreamingBlurRenderer::render(int inputWidth, int inputHeight, float radius, BlurEdgeMode edgeMode,
+                                   const RowSource& source, const RowSink& sink) {
+    bool clampEdges = edgeMode == BlurEdgeMode::Rectangle;
+    int padding = calculatePadding(radius, edgeMode);
+    int outputWidth = inputWidth + 2 * padding;
+    int outputHeight = inputHeight + 2 * padding;
+
+    weights_ = CpuBlurRenderer::calculateWeights(radius);
+    kernelRadius_ = static_cast<int>(weights_.size() / 2);
+
+    // An output band needs the input rows of its own height plus the kernel reach on both sides,
+    // older rows are overwritten as new ones arrive
+    ringRows_ = 2 * kernelRadius_ + kBandHeight;
+    inputBand_.resize(static_cast<size_t>(kBandHeight) * inputWidth * 4);
+    inputRows_.resize(kBandHeight);
+    ring_.resize(static_cast<size_t>(ringRows_) * outputWidth * 4);
+    outputBand_.resize(static_cast<size_t>(kBandHeight) * outputWidth * 4);
+
+    int nextInputRow = 0;
+    for (int firstRow = 0; firstRow < outputHeight; firstRow += kBandHeight) {
+        int rowCount = std::min(kBandHeight, outputHeight - firstRow);
+
+        // Read and blur horizontally every input row the band reaches
+        int lastNeededRow = std::min(inputHeight - 1, firstRow + rowCount - 1 - padding + kernelRadius_);
+        while (nextInputRow <= lastNeededRow) {
+            int readCount = std::min(kBandHeight, lastNeededRow - nextInputRow + 1);
+            for (int i = 0; i < readCount; ++i) {
+                unsigned char* scratch = inputBand_.data() + static_cast<size_t>(i) * inputWidth * 4;
+                inputRows_[i] = source(nextInputRow + i, scratch);
+            }
+            horizontalPass(nextInputRow, readCount, inputWidth, outputWidth, padding, clampEdges);
+            nextInputRow += readCount;
+        }
+
+        verticalPass(firstRow, rowCount, inputHeight, outputWidth, padding, clampEdges);
+        for (int i = 0; i < rowCount; ++i) {
+            sink(firstRow + i, outputBand_.data() + static_cast<size_t>(i) * outputWidth * 4);
+        }
+    }
+}
+
+void StreamingBlurRenderer::renderFile(const std::string& inputPath, int inputWidth, int inputHeight,
+                                       float radius, BlurEdgeMode edgeMode, const std::string& outputPath) {
+    size_t rowBytes = static_cast<size_t>(inputWidth) * 4;
+    MappedFile input(inputPath, rowBytes * inputHeight);
+    OutputFile output(outputPath);
+
+    size_t released = 0;
+    int padding = calculatePadding(radius, edgeMode);
+    size_t outputRowBytes = static_cast<size_t>(inputWidth + 2 * padding) * 4;
+
+    render(inputWidth, inputHeight, radius, edgeMode,
+           [&](int y, unsigned char*) -> const unsigned char* {
+               // Rows before the previous band went through the horizontal pass already
+               size_t consumed = static_cast<size_t>(std::max(0, y - kBandHeight)) * rowBytes;
+               if (consumed - released >= kReleaseStep) {
+                   input.release(consumed);
+                   released = consumed;
+               }
+               return input.data() + static_cast<size_t>(y) * rowBytes;
+           },
+           [&](int, const unsigned char* row) {
+               output.write(row, outputRowBytes);
+           });
+
+    output.close();
+}
+
+void StreamingBlurRenderer::horizontalPass(int firstRow, int rowCount, int inputWidth, int outputWidth,
+                                           int padding, bool clampEdges) {
+    int margin = padding + kernelRadius_;
+
+    pool_.parallelFor(rowCount, [&](int i) {
+        const unsigned char* sourceRow = inputRows_[i];
+        unsigned char* targetRow = ringRow(firstRow + i, outputWidth);
+
+        // Source row extended by the halo on both sides, so the tap loop needs no bounds checks
+        std::vector<unsigned char> extendedRow(static_cast<size_t>(inputWidth + 2 * margin) * 4);
+        for (int x = -margin; x < inputWidth + margin; ++x) {
+            unsigned char* pixel = extendedRow.data() + (x + margin) * 4;
+            if (x >= 0 && x < inputWidth) {
+                std::copy(sourceRow + x * 4, sourceRow + x * 4 + 4, pixel);
+            } else if (clampEdges) {
+                int edgeX = x < 0 ? 0 : inputWidth - 1;
+                std::copy(sourceRow + edgeX * 4, sourceRow + edgeX * 4 + 4, pixel);
+            } else {
+                std::fill(pixel, pixel + 4, 0);
+            }
+        }
+
+        for (int x = 0; x < outputWidth; ++x) {
+            const unsigned char* taps = extendedRow.data() + x * 4;
+            float r = 0.0f, g = 0.0f, b = 0.0f, a = 0.0f;
+
+            for (size_t k = 0; k < weights_.size(); ++k) {
+                float weight = weights_[k];
+                const unsigned char* pixel = taps + k * 4;
+                r += pixel[0] * weight;
+                g += pixel[1] * weight;
+                b += pixel[2] * weight;
+                a += pixel[3] * weight;
+            }
+
+            unsigned char* target = targetRow + x * 4;
+            target[0] = toByte(r);
+            target[1] = toByte(g);
+            target[2] = toByte(b);
+            target[3] = toByte(a);
+        }
+    });
+}
+
+void StreamingBlurRenderer::verticalPass(int firstRow, int rowCount, int inputHeight, int outputWidth,
+                                         int padding, bool clampEdges) {
+    int tileColumns = (outputWidth + kTileWidth - 1) / kTileWidth;
+
+    pool_.parallelFor(rowCount * tileColumns, [&](int tile) {
+        int y = firstRow + tile / tileColumns;
+        int firstColumn = (tile % tileColumns) * kTileWidth;
+        int channelCount = std::min(kTileWidth, outputWidth - firstColumn) * 4;
+
+        float accumulator[kTileWidth * 4];
+        std::fill(accumulator, accumulator + channelCount, 0.0f);
+
+        for (int k = -kernelRadius_; k <= kernelRadius_; ++k) {
+            int sourceY = y - padding + k;
+            if (sourceY < 0 || sourceY >= inputHeight) {
+                if (!clampEdges) continue;
+                sourceY = std::min(std::max(sourceY, 0), inputHeight - 1);
+            }
+
+            float weight = weights_[k + kernelRadius_];
+            const unsigned char* source = ringRow(sourceY, outputWidth) + firstColumn * 4;
+            for (int i = 0; i < channelCount; ++i) {
+                accumulator[i] += source[i] * weight;
+            }
+        }
+
+        unsigned char* target = outputBand_.data() +
+                (static_cast<size_t>(y - firstRow) * outputWidth + firstColumn) * 4;
+        for (int i = 0; i < channelCount; ++i) {
+            target[i] = toByte(accumulator[i]);
+        }
+    });
+}
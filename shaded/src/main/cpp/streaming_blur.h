@@ -0,0 +1,69 @@
+#ifndef STREAMING_BLUR_H
+#define STREAMING_BLUR_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+#include "blur_edge_mode.h"
+#include "thread_pool.h"
+
+// Blurs images too large to hold in memory, row by row, with the kernel of CpuBlurRenderer and
+// the same results. Input rows are read in order and blurred horizontally into a ring of the
+// last 2 * ceil(radius) + kBandHeight rows, and every output row is blurred vertically out of
+// that ring as soon as the input rows it needs have arrived. Memory use is O(width * radius)
+// whatever the height of the image.
+//
+// Works on tightly packed RGBA8888 rows. Not thread safe, callers serialize render().
+class StreamingBlurRenderer {
+public:
+    // Returns input row y (inputWidth * 4 bytes): either scratch filled with it, or memory of its
+    // own that stays valid until render() returns. Rows are asked for once each, in order.
+    using RowSource = std::function<const unsigned char*(int y, unsigned char* scratch)>;
+    // Receives output row y (outputWidth * 4 bytes), in order. row is only valid during the call.
+    using RowSink = std::function<void(int y, const unsigned char* row)>;
+
+    // Rows blurred per parallel step, horizontally as they arrive and vertically as they leave
+    static constexpr int kBandHeight = 16;
+
+    explicit StreamingBlurRenderer(int threadCount);
+
+    // Output rows are as wide as the input grown by calculatePadding on both sides, and there
+    // are inputHeight + 2 * calculatePadding of them
+    void render(int inputWidth, int inputHeight, float radius, BlurEdgeMode edgeMode,
+                const RowSource& source, const RowSink& sink);
+
+    // Blurs a raw RGBA8888 file, mapped into memory and released behind the rows already read,
+    // into a raw RGBA8888 file of the output size
+    void renderFile(const std::string& inputPath, int inputWidth, int inputHeight, float radius,
+                    BlurEdgeMode edgeMode, const std::string& outputPath);
+
+    // 0 for the rectangle edge treatment, which keeps the input size
+    static int calculatePadding(float radius, BlurEdgeMode edgeMode);
+
+    // Bytes of row buffers the last render held on to
+    size_t bufferBytes() const;
+
+private:
+    void horizontalPass(int firstRow, int rowCount, int inputWidth, int outputWidth, int padding,
+                        bool clampEdges);
+    void verticalPass(int firstRow, int rowCount, int inputHeight, int outputWidth, int padding,
+                      bool clampEdges);
+
+    unsigned char* ringRow(int inputRow, int outputWidth);
+
+    ThreadPool pool_;
+
+    // Normalized weights for offsets -kernelRadius_ ... kernelRadius_
+    std::vector<float> weights_;
+    int kernelRadius_;
+    int ringRows_;
+
+    // Input rows of the band being read, their horizontal pass output, and the output band
+    std::vector<unsigned char> inputBand_;
+    std::vector<const unsigned char*> inputRows_;
+    std::vector<unsigned char> ring_;
+    std::vector<unsigned char> outputBand_;
+};
+
+#endif // STREAMING_BLUR_H
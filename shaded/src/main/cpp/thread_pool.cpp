@@ -0,0 +1,112 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threadCount)
+        : threadCount_(std::max(1, threadCount)), task_(nullptr), remaining_(0),
+          generation_(0), stopping_(false) {
+    for (int i = 0; i < threadCount_; ++i) {
+        queues_.push_back(std::make_unique<TaskQueue>());
+    }
+
+    // Participant 0 is whoever calls parallelFor
+    for (int i = 1; i < threadCount_; ++i) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeCondition_.notify_all();
+
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(int taskCount, const std::function<void(int)>& task) {
+    if (taskCount <= 0) return;
+
+    if (threadCount_ == 1 || taskCount == 1) {
+        for (int i = 0; i < taskCount; ++i) task(i);
+        return;
+    }
+
+    task_ = &task;
+    remaining_.store(taskCount);
+
+    // Hand out contiguous chunks so each participant starts on neighbouring rows/tiles
+    for (int q = 0; q < threadCount_; ++q) {
+        int begin = static_cast<int>(static_cast<long>(taskCount) * q / threadCount_);
+        int end = static_cast<int>(static_cast<long>(taskCount) * (q + 1) / threadCount_);
+
+        std::lock_guard<std::mutex> lock(queues_[q]->mutex);
+        for (int i = begin; i < end; ++i) {
+            queues_[q]->tasks.push_back(i);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++generation_;
+    }
+    wakeCondition_.notify_all();
+
+    runTasks(0);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCondition_.wait(lock, [this] { return remaining_.load() == 0; });
+    task_ = nullptr;
+}
+
+void ThreadPool::workerLoop(int index) {
+    unsigned long seenGeneration = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeCondition_.wait(lock, [&] { return stopping_ || generation_ != seenGeneration; });
+            if (stopping_) return;
+            seenGeneration = generation_;
+        }
+
+        runTasks(index);
+    }
+}
+
+void ThreadPool::runTasks(int index) {
+    int task;
+    while (popLocal(index, task) || steal(index, task)) {
+        (*task_)(task);
+
+        if (remaining_.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            doneCondition_.notify_all();
+        }
+    }
+}
+
+bool ThreadPool::popLocal(int index, int& task) {
+    TaskQueue& queue = *queues_[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(int index, int& task) {
+    for (int offset = 1; offset < threadCount_; ++offset) {
+        TaskQueue& victim = *queues_[(index + offset) % threadCount_];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+
+        task = victim.tasks.back();
+        victim.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool for data-parallel loops. Every participant owns a deque of task indices,
+// pops from its own front (neighbouring tasks, good locality) and steals from the back of others.
+class ThreadPool {
+public:
+    // threadCount includes the calling thread, which takes part in every parallelFor
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int threadCount() const { return threadCount_; }
+
+    // Runs task(0) ... task(taskCount - 1) across the pool and blocks until all of them finished.
+    // Only one parallelFor may run at a time.
+    void parallelFor(int taskCount, const std::function<void(int)>& task);
+
+private:
+    struct TaskQueue {
+        std::mutex mutex;
+        std::deque<int> tasks;
+    };
+
+    void workerLoop(int index);
+    void runTasks(int index);
+    bool popLocal(int index, int& task);
+    bool steal(int index, int& task);
+
+    int threadCount_;
+    std::vector<std::unique_ptr<TaskQueue>> queues_;
+    std::vector<std::thread> workers_;
+
+    const std::function<void(int)>* task_;
+    std::atomic<int> remaining_;
+
+    std::mutex mutex_;
+    std::condition_variable wakeCondition_;
+    std::condition_variable doneCondition_;
+    unsigned long generation_;
+    bool stopping_;
+};
+
+#endif // THREAD_POOL_H
@@ -1,15 +1,17 @@
 #include "unbounded_blur.h"
+#include "readback_scale.h"
+#include "small_kernel.h"
 #include <cmath>
 #include <algorithm>
 
 UnboundedBlurRenderer::UnboundedBlurRenderer(int maxWidth, int maxHeight)
-        : eglHelper_(maxWidth, maxHeight),
-          quadVBO_(0), horizontalShaderProgram_(0), verticalShaderProgram_(0),
+        : quadVBO_(0), horizontalShaderProgram_(0), verticalShaderProgram_(0), singlePassShaderProgram_(0),
           attrPos_(-1), attrTexCoord_(-1),
-          uniformTexture_(-1), uniformRadius_(-1), uniformTextureSize_(-1),
-          uniformInputSize_(-1), uniformOutputSize_(-1),
+          horizontalUniforms_(), verticalUniforms_(), singlePassUniforms_(),
+          eglHelper_(maxWidth, maxHeight),
           framebuffer1_(0), framebuffer2_(0), fboTexture1_(0), fboTexture2_(0),
-          currentFBOWidth_(0), currentFBOHeight_(0),
+          currentFBOWidth_(0), currentFBOHeight_(0), currentOutputWidth_(0), currentOutputHeight_(0),
+          intermediateWidth_(0), intermediateHeight_(0), framebufferAllocations_(0),
           initialized_(false) {}
 
 void UnboundedBlurRenderer::initialize() {
@@ -21,10 +23,14 @@ void UnboundedBlurRenderer::initialize() {
     setupFullscreenQuad();
     setupFramebuffers();
 
+    // Everything outside the drawn image is transparent
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
     initialized_ = true;
 }
 
-GLuint UnboundedBlurRenderer::uploadBitmapAsTexture(unsigned char *pixels, int width, int height) {
+GLuint UnboundedBlurRenderer::uploadBitmapAsTexture(const unsigned char* pixels, int width, int height,
+                                                 PixelFormat format, int stride) {
     initialize();
     eglHelper_.makeCurrent();
 
@@ -32,8 +38,7 @@ GLuint UnboundedBlurRenderer::uploadBitmapAsTexture(unsigned char *pixels, int w
     glGenTextures(1, &textureId);
     glBindTexture(GL_TEXTURE_2D, textureId);
 
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    uploadPixels(pixels, width, height, format, stride);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -43,148 +48,124 @@ GLuint UnboundedBlurRenderer::uploadBitmapAsTexture(unsigned char *pixels, int w
     return textureId;
 }
 
+int UnboundedBlurRenderer::calculatePadding(float radius) {
+    // The kernel reaches ceil(radius) pixels past the input on every side, like the CPU and
+    // Vulkan renderers. Whole pixels keep the input on the output's pixel grid.
+    return std::max(0, static_cast<int>(std::ceil(radius)));
+}
+
 int UnboundedBlurRenderer::calculateOutputSize(int inputSize, float radius) {
-    // For unbounded blur, we need to expand the output by the blur radius on all sides
-    // This ensures the blur effect extends beyond the original image boundaries
-    int expansion = static_cast<int>(std::ceil(radius * 2.0f));
-    return inputSize + expansion;
+    return inputSize + 2 * calculatePadding(radius);
 }
 
 void UnboundedBlurRenderer::render(GLuint textureId, int inputWidth, int inputHeight,
-                                   float radius, int &outputWidth, int &outputHeight) {
+                                   float radius, int downscale, int &outputWidth, int &outputHeight) {
     initialize();
     eglHelper_.makeCurrent();
 
-    // Calculate output dimensions
-    outputWidth = calculateOutputSize(inputWidth, radius);
-    outputHeight = calculateOutputSize(inputHeight, radius);
+    // Calculate output dimensions, the passes work in the expanded space and only the
+    // framebuffers they render into shrink
+    int expandedWidth = calculateOutputSize(inputWidth, radius);
+    int expandedHeight = calculateOutputSize(inputHeight, radius);
+    outputWidth = calculateDownscaledSize(expandedWidth, downscale);
+    outputHeight = calculateDownscaledSize(expandedHeight, downscale);
 
     // Resize framebuffers if needed
-    if (outputWidth != currentFBOWidth_ || outputHeight != currentFBOHeight_) {
-        resizeFramebuffers(outputWidth, outputHeight);
-    }
+    resizeFramebuffers(expandedWidth, expandedHeight, outputWidth, outputHeight);
 
-    if (radius <= 0.5f) {
-        // No blur needed, just render directly
-        renderDirect(textureId, inputWidth, inputHeight, outputWidth, outputHeight);
+    // Also copies the input into the padded output when there's nothing to blur
+    if (radius <= kSinglePassMaxRadius) {
+        renderSinglePass(textureId, inputWidth, inputHeight, expandedWidth, expandedHeight, radius);
         return;
     }
 
+    // Rows above and below the input are empty before the vertical pass, so the horizontal pass
+    // only covers the input rows and the vertical pass is the only one growing into the padding
+    resizeIntermediate(outputWidth, inputHeight);
+
     // First pass: Horizontal blur
-    renderHorizontalPass(textureId, inputWidth, inputHeight, outputWidth, outputHeight, radius);
+    renderHorizontalPass(textureId, inputWidth, inputHeight, expandedWidth, expandedHeight, radius);
 
     // Second pass: Vertical blur
-    renderVerticalPass(inputWidth, inputHeight, outputWidth, outputHeight, radius);
+    renderVerticalPass(inputWidth, inputHeight, expandedWidth, expandedHeight, radius);
+}
+
+void UnboundedBlurRenderer::setGeometry(const ProgramUniforms& uniforms, int inputWidth, int inputHeight,
+                                        int expandedWidth, int expandedHeight, float radius) {
+    float padding = static_cast<float>(calculatePadding(radius));
+    glUniform2f(uniforms.inputSize, static_cast<float>(inputWidth), static_cast<float>(inputHeight));
+    // Maps expanded texture coordinates to input ones: input = expanded * xy - zw
+    glUniform4f(uniforms.expansion,
+                static_cast<float>(expandedWidth) / static_cast<float>(inputWidth),
+                static_cast<float>(expandedHeight) / static_cast<float>(inputHeight),
+                padding / static_cast<float>(inputWidth),
+                padding / static_cast<float>(inputHeight));
 }
 
 void UnboundedBlurRenderer::renderHorizontalPass(GLuint textureId, int inputWidth, int inputHeight,
-                                                 int outputWidth, int outputHeight, float radius) {
+                                                 int expandedWidth, int expandedHeight, float radius) {
     glUseProgram(horizontalShaderProgram_);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1_);
-    glViewport(0, 0, outputWidth, outputHeight);
+    glViewport(0, 0, intermediateWidth_, intermediateHeight_);
 
-    // Clear with transparent background
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    // Every pixel gets drawn, the clear only spares tiled GPUs loading the previous contents
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Set uniforms
-    glUniform1f(glGetUniformLocation(horizontalShaderProgram_, "uRadius"), radius);
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uTextureSize"),
-                static_cast<float>(inputWidth), static_cast<float>(inputHeight));
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uInputSize"),
-                static_cast<float>(inputWidth), static_cast<float>(inputHeight));
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uOutputSize"),
-                static_cast<float>(outputWidth), static_cast<float>(outputHeight));
+    glUniform1f(horizontalUniforms_.radius, radius);
+    setGeometry(horizontalUniforms_, inputWidth, inputHeight, expandedWidth, expandedHeight, radius);
 
     // Bind input texture
-    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureId);
-    glUniform1i(glGetUniformLocation(horizontalShaderProgram_, "uTexture"), 0);
-
-    drawQuad(horizontalShaderProgram_);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    drawQuad();
 }
 
 void UnboundedBlurRenderer::renderVerticalPass(int inputWidth, int inputHeight,
-                                               int outputWidth, int outputHeight, float radius) {
+                                               int expandedWidth, int expandedHeight, float radius) {
     glUseProgram(verticalShaderProgram_);
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
-    glViewport(0, 0, outputWidth, outputHeight);
+    glViewport(0, 0, currentOutputWidth_, currentOutputHeight_);
 
-    // Clear with transparent background
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Set uniforms
-    glUniform1f(glGetUniformLocation(verticalShaderProgram_, "uRadius"), radius);
-    glUniform2f(glGetUniformLocation(verticalShaderProgram_, "uTextureSize"),
-                static_cast<float>(outputWidth), static_cast<float>(outputHeight)); // Note: using output size for intermediate texture
-    glUniform2f(glGetUniformLocation(verticalShaderProgram_, "uInputSize"),
-                static_cast<float>(inputWidth), static_cast<float>(inputHeight));
-    glUniform2f(glGetUniformLocation(verticalShaderProgram_, "uOutputSize"),
-                static_cast<float>(outputWidth), static_cast<float>(outputHeight));
+    glUniform1f(verticalUniforms_.radius, radius);
+    setGeometry(verticalUniforms_, inputWidth, inputHeight, expandedWidth, expandedHeight, radius);
 
     // Bind intermediate texture from horizontal pass
-    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, fboTexture1_);
-    glUniform1i(glGetUniformLocation(verticalShaderProgram_, "uTexture"), 0);
-
-    drawQuad(verticalShaderProgram_);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    drawQuad();
 }
 
-void UnboundedBlurRenderer::renderDirect(GLuint textureId, int inputWidth, int inputHeight,
-                                         int outputWidth, int outputHeight) {
-    // For no blur case, we still need to expand the canvas and center the image
-    glUseProgram(horizontalShaderProgram_); // Reuse horizontal shader with radius 0
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
-    glViewport(0, 0, outputWidth, outputHeight);
+void UnboundedBlurRenderer::renderSinglePass(GLuint textureId, int inputWidth, int inputHeight,
+                                             int expandedWidth, int expandedHeight, float radius) {
+    // Taps straddling the image edge mix in transparent texels, so unlike the rectangle
+    // renderer the 5x5 kernel can't fold into bilinear fetches
+    float weights[3];
+    calculateSmallKernelWeights(radius, weights);
 
-    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+    glUseProgram(singlePassShaderProgram_);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
+    glViewport(0, 0, currentOutputWidth_, currentOutputHeight_);
 
-    glUniform1f(glGetUniformLocation(horizontalShaderProgram_, "uRadius"), 0.0f);
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uTextureSize"),
-                static_cast<float>(inputWidth), static_cast<float>(inputHeight));
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uInputSize"),
-                static_cast<float>(inputWidth), static_cast<float>(inputHeight));
-    glUniform2f(glGetUniformLocation(horizontalShaderProgram_, "uOutputSize"),
-                static_cast<float>(outputWidth), static_cast<float>(outputHeight));
+    glUniform1f(singlePassUniforms_.radius, radius);
+    glUniform3f(singlePassUniforms_.weights, weights[0], weights[1], weights[2]);
+    setGeometry(singlePassUniforms_, inputWidth, inputHeight, expandedWidth, expandedHeight, radius);
 
-    glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, textureId);
-    glUniform1i(glGetUniformLocation(horizontalShaderProgram_, "uTexture"), 0);
-
-    drawQuad(horizontalShaderProgram_);
 
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    drawQuad();
 }
 
-void UnboundedBlurRenderer::drawQuad(GLuint shaderProgram) {
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
-
-    GLint posLoc = glGetAttribLocation(shaderProgram, "aPosition");
-    GLint texLoc = glGetAttribLocation(shaderProgram, "aTexCoord");
-
-    glEnableVertexAttribArray(posLoc);
-    glVertexAttribPointer(posLoc, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-
-    glEnableVertexAttribArray(texLoc);
-    glVertexAttribPointer(texLoc, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-
+void UnboundedBlurRenderer::drawQuad() {
+    // Vertex attributes are specified once in setupFullscreenQuad and stay enabled
     glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-    glDisableVertexAttribArray(posLoc);
-    glDisableVertexAttribArray(texLoc);
 }
 
-void UnboundedBlurRenderer::readFBO(unsigned char *pixels, int width, int height) {
+void UnboundedBlurRenderer::readFBO(unsigned char* pixels, int width, int height, PixelFormat format, int stride) {
     eglHelper_.makeCurrent();
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_); // Read from final output
-    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    readPixels(pixels, width, height, format, stride);
 }
 
 void UnboundedBlurRenderer::setupFullscreenQuad() {
@@ -198,7 +179,12 @@ void UnboundedBlurRenderer::setupFullscreenQuad() {
     glGenBuffers(1, &quadVBO_);
     glBindBuffer(GL_ARRAY_BUFFER, quadVBO_);
     glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), quadVertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Every program binds the same attribute locations, so the quad stays set up for all of them
+    glEnableVertexAttribArray(attrPos_);
+    glVertexAttribPointer(attrPos_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(attrTexCoord_);
+    glVertexAttribPointer(attrTexCoord_, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 }
 
 void UnboundedBlurRenderer::setupFramebuffers() {
@@ -212,35 +198,54 @@ void UnboundedBlurRenderer::setupFramebuffers() {
     // Start with default sizes, will be resized as needed
     currentFBOWidth_ = 0;
     currentFBOHeight_ = 0;
+    currentOutputWidth_ = 0;
+    currentOutputHeight_ = 0;
 }
 
-void UnboundedBlurRenderer::resizeFramebuffers(int width, int height) {
-    if (currentFBOWidth_ == width && currentFBOHeight_ == height) {
+void UnboundedBlurRenderer::resizeFramebuffers(int width, int height, int outputWidth, int outputHeight) {
+    if (currentFBOWidth_ == width && currentFBOHeight_ == height &&
+        currentOutputWidth_ == outputWidth && currentOutputHeight_ == outputHeight) {
         return; // No resize needed
     }
 
+    ++framebufferAllocations_;
     currentFBOWidth_ = width;
     currentFBOHeight_ = height;
+    currentOutputWidth_ = outputWidth;
+    currentOutputHeight_ = outputHeight;
 
-    // Setup first framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1_);
-    glBindTexture(GL_TEXTURE_2D, fboTexture1_);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    // Setup second framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
+    glBindTexture(GL_TEXTURE_2D, fboTexture2_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, outputWidth, outputHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture1_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture2_, 0);
 
-    // Setup second framebuffer
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer2_);
-    glBindTexture(GL_TEXTURE_2D, fboTexture2_);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void UnboundedBlurRenderer::resizeIntermediate(int width, int height) {
+    if (intermediateWidth_ == width && intermediateHeight_ == height) {
+        return;
+    }
+
+    ++framebufferAllocations_;
+    intermediateWidth_ = width;
+    intermediateHeight_ = height;
+
+    // Only the two-pass blur renders into the first framebuffer.
+    // It spans the output width but only the input rows.
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer1_);
+    glBindTexture(GL_TEXTURE_2D, fboTexture1_);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture2_, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fboTexture1_, 0);
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
@@ -264,7 +269,34 @@ GLuint UnboundedBlurRenderer::compileShader(GLenum type, const char *source) {
     return shader;
 }
 
+GLuint UnboundedBlurRenderer::linkProgram(GLuint vertexShader, GLuint fragmentShader) {
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertexShader);
+    glAttachShader(program, fragmentShader);
+    glBindAttribLocation(program, attrPos_, "aPosition");
+    glBindAttribLocation(program, attrTexCoord_, "aTexCoord");
+    glLinkProgram(program);
+
+    // The sampled texture is always bound to unit 0
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+
+    return program;
+}
+
+UnboundedBlurRenderer::ProgramUniforms UnboundedBlurRenderer::lookupUniforms(GLuint program) {
+    ProgramUniforms uniforms;
+    uniforms.radius = glGetUniformLocation(program, "uRadius");
+    uniforms.inputSize = glGetUniformLocation(program, "uInputSize");
+    uniforms.expansion = glGetUniformLocation(program, "uExpansion");
+    uniforms.weights = glGetUniformLocation(program, "uWeights");
+    return uniforms;
+}
+
 void UnboundedBlurRenderer::compileShaders() {
+    attrPos_ = 0;
+    attrTexCoord_ = 1;
+
     const char *vertexShaderSrc = R"(
         attribute vec2 aPosition;
         attribute vec2 aTexCoord;
@@ -275,35 +307,32 @@ void UnboundedBlurRenderer::compileShaders() {
         }
     )";
 
-    // Optimized horizontal blur fragment shader for unbounded blur
+    // Horizontal pass over the input rows only, spanning the expanded width. All unbounded shaders
+    // map expanded coordinates back into the input, which at mediump drifts by a tenth of a texel
+    // on inputs a few hundred pixels wide, so they use highp where it's available.
     const char *horizontalFragmentShaderSrc = R"(
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
 precision mediump float;
+#endif
 varying vec2 vTexCoord;
 uniform sampler2D uTexture;
 uniform float uRadius;
-uniform vec2 uTextureSize;
 uniform vec2 uInputSize;
-uniform vec2 uOutputSize;
+uniform vec4 uExpansion; // Input coordinate = expanded coordinate * xy - zw
 
-void main() {
-    // Map from expanded output coordinates to original texture coordinates
-    // The original image should be centered in the expanded output
-    vec2 expansion = vec2(uRadius) / uOutputSize;
-    vec2 originalCoord = (vTexCoord - expansion) / (1.0 - 2.0 * expansion);
+// 1 from the first to the last texel center, falling to 0 half a texel outside the image
+float edgeCoverage(float coord, float size) {
+    return clamp(0.5 + min(coord, 1.0 - coord) * size, 0.0, 1.0);
+}
 
-    vec2 texelSize = 1.0 / uInputSize;
+void main() {
+    // Rows map 1:1 to input rows, columns to the expanded width around the input
+    float originalX = vTexCoord.x * uExpansion.x - uExpansion.z;
+    float texelWidth = 1.0 / uInputSize.x;
     vec4 color = vec4(0.0);
 
-    if (uRadius <= 0.5) {
-        if (originalCoord.x >= 0.0 && originalCoord.x <= 1.0 &&
-            originalCoord.y >= 0.0 && originalCoord.y <= 1.0) {
-            gl_FragColor = texture2D(uTexture, originalCoord);
-        } else {
-            gl_FragColor = vec4(0.0, 0.0, 0.0, 0.0);
-        }
-        return;
-    }
-
     float sigma = uRadius / 2.0;
     float twoSigmaSq = 2.0 * sigma * sigma;
     float totalWeight = 0.0;
@@ -313,18 +342,12 @@ void main() {
     for (int x = -iRadius; x <= iRadius; ++x) {
         float distance = abs(float(x));
         if (distance <= uRadius) {
-            vec2 offset = vec2(float(x) * texelSize.x, 0.0);
-            vec2 sampleCoord = originalCoord + offset;
-
-            vec4 sample;
-            if (sampleCoord.x >= 0.0 && sampleCoord.x <= 1.0 &&
-                sampleCoord.y >= 0.0 && sampleCoord.y <= 1.0) {
-                // Sample from the original texture
-                sample = texture2D(uTexture, sampleCoord);
-            } else {
-                // Sample transparent black for pixels outside original bounds
-                sample = vec4(0.0, 0.0, 0.0, 0.0);
-            }
+            float sampleX = originalX + float(x) * texelWidth;
+
+            // Transparent black outside the original bounds, blended like a bilinear fetch
+            // against a transparent border where downscaled samples fall between texels
+            vec4 sample = texture2D(uTexture, vec2(sampleX, vTexCoord.y)) *
+                          edgeCoverage(sampleX, uInputSize.x);
 
             float weight = exp(-(distance * distance) / twoSigmaSq);
             color += sample * weight;
@@ -336,27 +359,30 @@ void main() {
 }
     )";
 
-    // Optimized vertical blur fragment shader for unbounded blur
+    // Vertical pass over the whole expanded output, reading the input rows of the horizontal pass
     const char *verticalFragmentShaderSrc = R"(
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
 precision mediump float;
+#endif
 varying vec2 vTexCoord;
 uniform sampler2D uTexture;
 uniform float uRadius;
-uniform vec2 uTextureSize;
 uniform vec2 uInputSize;
-uniform vec2 uOutputSize;
+uniform vec4 uExpansion; // Input coordinate = expanded coordinate * xy - zw
+
+// 1 from the first to the last texel center, falling to 0 half a texel outside the image
+float edgeCoverage(float coord, float size) {
+    return clamp(0.5 + min(coord, 1.0 - coord) * size, 0.0, 1.0);
+}
 
 void main() {
-    // For the vertical pass, we're sampling from the intermediate texture
-    // which is already in the expanded coordinate space
-    vec2 texelSize = 1.0 / uTextureSize; // Use the intermediate texture size
+    // Columns are already expanded, rows map back into the input rows of the intermediate texture
+    float originalY = vTexCoord.y * uExpansion.y - uExpansion.w;
+    float texelHeight = 1.0 / uInputSize.y;
     vec4 color = vec4(0.0);
 
-    if (uRadius <= 0.5) {
-        gl_FragColor = texture2D(uTexture, vTexCoord);
-        return;
-    }
-
     float sigma = uRadius / 2.0;
     float twoSigmaSq = 2.0 * sigma * sigma;
     float totalWeight = 0.0;
@@ -366,18 +392,11 @@ void main() {
     for (int y = -iRadius; y <= iRadius; ++y) {
         float distance = abs(float(y));
         if (distance <= uRadius) {
-            vec2 offset = vec2(0.0, float(y) * texelSize.y);
-            vec2 sampleCoord = vTexCoord + offset;
-
-            vec4 sample;
-            if (sampleCoord.x >= 0.0 && sampleCoord.x <= 1.0 &&
-                sampleCoord.y >= 0.0 && sampleCoord.y <= 1.0) {
-                // Sample from the intermediate texture
-                sample = texture2D(uTexture, sampleCoord);
-            } else {
-                // Sample transparent black for pixels outside bounds
-                sample = vec4(0.0, 0.0, 0.0, 0.0);
-            }
+            float sampleY = originalY + float(y) * texelHeight;
+
+            // Transparent black above and below the input rows
+            vec4 sample = texture2D(uTexture, vec2(vTexCoord.x, sampleY)) *
+                          edgeCoverage(sampleY, uInputSize.y);
 
             float weight = exp(-(distance * distance) / twoSigmaSq);
             color += sample * weight;
@@ -389,6 +408,56 @@ void main() {
 }
     )";
 
+    // Whole 5x5 kernel in one pass for small radii, with the same mapping into the expanded
+    // output as the two-pass blur. Radii up to 0.5 only copy the input into the padded output.
+    const char *singlePassFragmentShaderSrc = R"(
+#ifdef GL_FRAGMENT_PRECISION_HIGH
+precision highp float;
+#else
+precision mediump float;
+#endif
+varying vec2 vTexCoord;
+uniform sampler2D uTexture;
+uniform float uRadius;
+uniform vec3 uWeights; // Normalized weights at offsets 0, 1 and 2
+uniform vec2 uInputSize;
+uniform vec4 uExpansion; // Input coordinate = expanded coordinate * xy - zw
+
+float tapWeight(int offset) {
+    if (offset == 0) return uWeights.x;
+    if (offset == 1 || offset == -1) return uWeights.y;
+    return uWeights.z;
+}
+
+bool insideInput(vec2 coord) {
+    return coord.x >= 0.0 && coord.x <= 1.0 && coord.y >= 0.0 && coord.y <= 1.0;
+}
+
+void main() {
+    vec2 originalCoord = vTexCoord * uExpansion.xy - uExpansion.zw;
+
+    if (uRadius <= 0.5) {
+        gl_FragColor = insideInput(originalCoord) ? texture2D(uTexture, originalCoord) : vec4(0.0);
+        return;
+    }
+
+    vec2 texelSize = 1.0 / uInputSize;
+    vec4 color = vec4(0.0);
+
+    for (int y = -2; y <= 2; ++y) {
+        for (int x = -2; x <= 2; ++x) {
+            vec2 sampleCoord = originalCoord + vec2(float(x), float(y)) * texelSize;
+            // Transparent outside the original bounds
+            if (insideInput(sampleCoord)) {
+                color += texture2D(uTexture, sampleCoord) * (tapWeight(x) * tapWeight(y));
+            }
+        }
+    }
+
+    gl_FragColor = color;
+}
+    )";
+
     // Compile vertex shader (shared)
     GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSrc);
 
@@ -399,19 +468,23 @@ void main() {
     GLuint verticalFragmentShader = compileShader(GL_FRAGMENT_SHADER, verticalFragmentShaderSrc);
 
     // Create horizontal blur program
-    horizontalShaderProgram_ = glCreateProgram();
-    glAttachShader(horizontalShaderProgram_, vertexShader);
-    glAttachShader(horizontalShaderProgram_, horizontalFragmentShader);
-    glLinkProgram(horizontalShaderProgram_);
+    horizontalShaderProgram_ = linkProgram(vertexShader, horizontalFragmentShader);
 
     // Create vertical blur program
-    verticalShaderProgram_ = glCreateProgram();
-    glAttachShader(verticalShaderProgram_, vertexShader);
-    glAttachShader(verticalShaderProgram_, verticalFragmentShader);
-    glLinkProgram(verticalShaderProgram_);
+    verticalShaderProgram_ = linkProgram(vertexShader, verticalFragmentShader);
+
+    // Create single pass program
+    GLuint singlePassFragmentShader = compileShader(GL_FRAGMENT_SHADER, singlePassFragmentShaderSrc);
+    singlePassShaderProgram_ = linkProgram(vertexShader, singlePassFragmentShader);
 
     // Clean up shaders
     glDeleteShader(vertexShader);
     glDeleteShader(horizontalFragmentShader);
     glDeleteShader(verticalFragmentShader);
+    glDeleteShader(singlePassFragmentShader);
+
+    // Uniform locations don't change after linking, look them up once
+    horizontalUniforms_ = lookupUniforms(horizontalShaderProgram_);
+    verticalUniforms_ = lookupUniforms(verticalShaderProgram_);
+    singlePassUniforms_ = lookupUniforms(singlePassShaderProgram_);
 }
\ No newline at end of file
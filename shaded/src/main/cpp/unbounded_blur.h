@@ -3,6 +3,7 @@
 
 #include <GLES2/gl2.h>
 #include "egl_helper.h"
+#include "pixel_format.h"
 // Include your EGL helper header
 // #include "egl_helper.h"
 
@@ -12,13 +13,24 @@ public:
     ~UnboundedBlurRenderer() = default;
 
     void initialize();
-    GLuint uploadBitmapAsTexture(unsigned char* pixels, int width, int height);
+    // stride is the row size in bytes of pixels
+    GLuint uploadBitmapAsTexture(const unsigned char* pixels, int width, int height,
+                                 PixelFormat format, int stride);
+    // The result is the input grown by calculatePadding(radius) on every side. outputWidth /
+    // outputHeight receive the size of the final pass, which is that expanded size reduced by
+    // downscale per axis.
     void render(GLuint textureId, int inputWidth, int inputHeight,
-                float radius, int& outputWidth, int& outputHeight);
-    void readFBO(unsigned char* pixels, int width, int height);
+                float radius, int downscale, int& outputWidth, int& outputHeight);
+    // Blurs always render into RGBA8888 targets, read back natively in format where GL can
+    void readFBO(unsigned char* pixels, int width, int height, PixelFormat format, int stride);
 
+    // Pixels the blur grows the input by on each side, the one padding every caller lays out with
+    static int calculatePadding(float radius);
     static int calculateOutputSize(int inputSize, float radius);
 
+    // Number of times the framebuffer textures were (re)allocated, they are reused while sizes repeat
+    int framebufferAllocations() const { return framebufferAllocations_; }
+
 private:
     // EGL and OpenGL setup
     // EGLHelper eglHelper_;  // Replace with your actual EGL helper class
@@ -27,15 +39,21 @@ private:
     GLuint quadVBO_;
     GLuint horizontalShaderProgram_;
     GLuint verticalShaderProgram_;
+    GLuint singlePassShaderProgram_;
 
-    // Shader attributes and uniforms
+    // Shader attributes and uniforms. Attribute locations are bound to the same indices in every
+    // program and uniform locations are looked up once after linking.
+    struct ProgramUniforms {
+        GLint radius;
+        GLint inputSize;
+        GLint expansion;
+        GLint weights;
+    };
     GLint attrPos_;
     GLint attrTexCoord_;
-    GLint uniformTexture_;
-    GLint uniformRadius_;
-    GLint uniformTextureSize_;
-    GLint uniformInputSize_;
-    GLint uniformOutputSize_;
+    ProgramUniforms horizontalUniforms_;
+    ProgramUniforms verticalUniforms_;
+    ProgramUniforms singlePassUniforms_;
 
     EGLHelper eglHelper_;  // Offscreen EGL context manager
 
@@ -49,24 +67,34 @@ private:
     // Current framebuffer dimensions
     int currentFBOWidth_;
     int currentFBOHeight_;
+    int currentOutputWidth_;   // Output framebuffer and the intermediate width may be downscaled
+    int currentOutputHeight_;
+    int intermediateWidth_;    // fboTexture1_ is only allocated once a two-pass blur needs it
+    int intermediateHeight_;
+    int framebufferAllocations_;
 
     bool initialized_;
 
     // Helper methods
     void setupFullscreenQuad();
     void setupFramebuffers();
-    void resizeFramebuffers(int width, int height);
+    void resizeFramebuffers(int width, int height, int outputWidth, int outputHeight);
+    void resizeIntermediate(int width, int height);
     void compileShaders();
     GLuint compileShader(GLenum type, const char* source);
+    GLuint linkProgram(GLuint vertexShader, GLuint fragmentShader);
+    ProgramUniforms lookupUniforms(GLuint program);
 
     // Rendering passes
     void renderHorizontalPass(GLuint textureId, int inputWidth, int inputHeight,
-                              int outputWidth, int outputHeight, float radius);
+                              int expandedWidth, int expandedHeight, float radius);
     void renderVerticalPass(int inputWidth, int inputHeight,
-                            int outputWidth, int outputHeight, float radius);
-    void renderDirect(GLuint textureId, int inputWidth, int inputHeight,
-                      int outputWidth, int outputHeight);
-    void drawQuad(GLuint shaderProgram);
+                            int expandedWidth, int expandedHeight, float radius);
+    void renderSinglePass(GLuint textureId, int inputWidth, int inputHeight,
+                          int expandedWidth, int expandedHeight, float radius);
+    void setGeometry(const ProgramUniforms& uniforms, int inputWidth, int inputHeight,
+                     int expandedWidth, int expandedHeight, float radius);
+    void drawQuad();
 };
 
 #endif // UNBOUNDED_BLUR_H
\ No newline at end of file
@@ -0,0 +1,521 @@
+#include "vulkan_blur.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <dlfcn.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+    // Compiled from shaders/blur.comp by glslc at build time
+    const uint32_t kBlurShaderSpirv[] =
+#include "blur.comp.spv.inc"
+    ;
+
+    constexpr uint32_t kGroupSize = 256;
+
+    struct PassParameters {
+        int32_t sourceLength;
+        int32_t rowCount;
+        int32_t destinationLength;
+        int32_t padding;
+        int32_t kernelRadius;
+        int32_t clampEdges;
+    };
+
+    void check(VkResult result, const char* what) {
+        if (result != VK_SUCCESS) {
+            throw std::runtime_error(std::string(what) + " failed (" + std::to_string(result) + ").");
+        }
+    }
+}
+
+#define VULKAN_INSTANCE_FUNCTIONS(X) \
+    X(vkDestroyInstance) \
+    X(vkEnumeratePhysicalDevices) \
+    X(vkGetPhysicalDeviceProperties) \
+    X(vkGetPhysicalDeviceQueueFamilyProperties) \
+    X(vkGetPhysicalDeviceMemoryProperties) \
+    X(vkCreateDevice) \
+    X(vkGetDeviceProcAddr)
+
+#define VULKAN_DEVICE_FUNCTIONS(X) \
+    X(vkDestroyDevice) \
+    X(vkGetDeviceQueue) \
+    X(vkDeviceWaitIdle) \
+    X(vkCreateBuffer) \
+    X(vkDestroyBuffer) \
+    X(vkGetBufferMemoryRequirements) \
+    X(vkAllocateMemory) \
+    X(vkFreeMemory) \
+    X(vkBindBufferMemory) \
+    X(vkMapMemory) \
+    X(vkUnmapMemory) \
+    X(vkFlushMappedMemoryRanges) \
+    X(vkInvalidateMappedMemoryRanges) \
+    X(vkCreateShaderModule) \
+    X(vkDestroyShaderModule) \
+    X(vkCreateDescriptorSetLayout) \
+    X(vkDestroyDescriptorSetLayout) \
+    X(vkCreatePipelineLayout) \
+    X(vkDestroyPipelineLayout) \
+    X(vkCreateComputePipelines) \
+    X(vkDestroyPipeline) \
+    X(vkCreateDescriptorPool) \
+    X(vkDestroyDescriptorPool) \
+    X(vkAllocateDescriptorSets) \
+    X(vkUpdateDescriptorSets) \
+    X(vkCreateCommandPool) \
+    X(vkDestroyCommandPool) \
+    X(vkAllocateCommandBuffers) \
+    X(vkResetCommandBuffer) \
+    X(vkBeginCommandBuffer) \
+    X(vkEndCommandBuffer) \
+    X(vkCmdBindPipeline) \
+    X(vkCmdBindDescriptorSets) \
+    X(vkCmdPushConstants) \
+    X(vkCmdDispatch) \
+    X(vkCmdPipelineBarrier) \
+    X(vkCreateFence) \
+    X(vkDestroyFence) \
+    X(vkResetFences) \
+    X(vkWaitForFences) \
+    X(vkQueueSubmit)
+
+#define VULKAN_DECLARE_FUNCTION(name) PFN_##name name = nullptr;
+
+// Entry points resolved from libvulkan at runtime, so devices without Vulkan still load the library
+struct VulkanFunctions {
+    PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr = nullptr;
+    PFN_vkCreateInstance vkCreateInstance = nullptr;
+    VULKAN_INSTANCE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_DECLARE_FUNCTION)
+};
+
+VulkanBlurRenderer::VulkanBlurRenderer()
+        : library_(nullptr), vk_(new VulkanFunctions()),
+          instance_(VK_NULL_HANDLE), physicalDevice_(VK_NULL_HANDLE), memoryProperties_(),
+          device_(VK_NULL_HANDLE), queue_(VK_NULL_HANDLE), queueFamily_(0), deviceName_(),
+          descriptorSetLayout_(VK_NULL_HANDLE), pipelineLayout_(VK_NULL_HANDLE), pipeline_(VK_NULL_HANDLE),
+          descriptorPool_(VK_NULL_HANDLE), commandPool_(VK_NULL_HANDLE) {
+    library_ = dlopen("libvulkan.so", RTLD_NOW | RTLD_LOCAL);
+    if (!library_) library_ = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+    if (!library_) throw std::runtime_error("libvulkan is not available.");
+
+    try {
+        createInstance();
+        createDevice();
+        createPipeline();
+        createFrame();
+    } catch (...) {
+        release();
+        throw;
+    }
+}
+
+VulkanBlurRenderer::~VulkanBlurRenderer() {
+    release();
+}
+
+void VulkanBlurRenderer::release() {
+    // Creation may have failed half way, only objects that exist are destroyed
+    if (device_ != VK_NULL_HANDLE) {
+        if (vk_->vkDeviceWaitIdle) vk_->vkDeviceWaitIdle(device_);
+
+        destroyBuffer(frame_.input);
+        destroyBuffer(frame_.intermediate);
+        destroyBuffer(frame_.output);
+        destroyBuffer(frame_.weights);
+        if (frame_.fence != VK_NULL_HANDLE) vk_->vkDestroyFence(device_, frame_.fence, nullptr);
+        frame_.fence = VK_NULL_HANDLE;
+
+        if (commandPool_ != VK_NULL_HANDLE) vk_->vkDestroyCommandPool(device_, commandPool_, nullptr);
+        if (descriptorPool_ != VK_NULL_HANDLE) vk_->vkDestroyDescriptorPool(device_, descriptorPool_, nullptr);
+        if (pipeline_ != VK_NULL_HANDLE) vk_->vkDestroyPipeline(device_, pipeline_, nullptr);
+        if (pipelineLayout_ != VK_NULL_HANDLE) vk_->vkDestroyPipelineLayout(device_, pipelineLayout_, nullptr);
+        if (descriptorSetLayout_ != VK_NULL_HANDLE) {
+            vk_->vkDestroyDescriptorSetLayout(device_, descriptorSetLayout_, nullptr);
+        }
+
+        if (vk_->vkDestroyDevice) vk_->vkDestroyDevice(device_, nullptr);
+        device_ = VK_NULL_HANDLE;
+    }
+
+    if (instance_ != VK_NULL_HANDLE && vk_->vkDestroyInstance) {
+        vk_->vkDestroyInstance(instance_, nullptr);
+        instance_ = VK_NULL_HANDLE;
+    }
+
+    if (library_) {
+        dlclose(library_);
+        library_ = nullptr;
+    }
+}
+
+void VulkanBlurRenderer::createInstance() {
+    vk_->vkGetInstanceProcAddr =
+            reinterpret_cast<PFN_vkGetInstanceProcAddr>(dlsym(library_, "vkGetInstanceProcAddr"));
+    if (!vk_->vkGetInstanceProcAddr) throw std::runtime_error("vkGetInstanceProcAddr not found.");
+
+    vk_->vkCreateInstance = reinterpret_cast<PFN_vkCreateInstance>(
+            vk_->vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkCreateInstance"));
+    if (!vk_->vkCreateInstance) throw std::runtime_error("vkCreateInstance not found.");
+
+    VkApplicationInfo applicationInfo{};
+    applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    applicationInfo.pApplicationName = "Shaded";
+    applicationInfo.pEngineName = "Shaded";
+    applicationInfo.apiVersion = VK_API_VERSION_1_0;
+
+    VkInstanceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    createInfo.pApplicationInfo = &applicationInfo;
+    check(vk_->vkCreateInstance(&createInfo, nullptr, &instance_), "vkCreateInstance");
+
+#define VULKAN_LOAD_INSTANCE_FUNCTION(name) \
+    vk_->name = reinterpret_cast<PFN_##name>(vk_->vkGetInstanceProcAddr(instance_, #name)); \
+    if (!vk_->name) throw std::runtime_error(#name " not found.");
+    VULKAN_INSTANCE_FUNCTIONS(VULKAN_LOAD_INSTANCE_FUNCTION)
+#undef VULKAN_LOAD_INSTANCE_FUNCTION
+}
+
+void VulkanBlurRenderer::createDevice() {
+    uint32_t deviceCount = 0;
+    vk_->vkEnumeratePhysicalDevices(instance_, &deviceCount, nullptr);
+    std::vector<VkPhysicalDevice> devices(deviceCount);
+    vk_->vkEnumeratePhysicalDevices(instance_, &deviceCount, devices.data());
+
+    // First device with a compute queue, preferring a real GPU over a software implementation
+    int bestScore = -1;
+    for (VkPhysicalDevice device : devices) {
+        uint32_t familyCount = 0;
+        vk_->vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vk_->vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, families.data());
+
+        for (uint32_t family = 0; family < familyCount; ++family) {
+            if (!(families[family].queueFlags & VK_QUEUE_COMPUTE_BIT)) continue;
+
+            VkPhysicalDeviceProperties properties;
+            vk_->vkGetPhysicalDeviceProperties(device, &properties);
+            int score = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU ? 0 : 1;
+            if (score > bestScore) {
+                bestScore = score;
+                physicalDevice_ = device;
+                queueFamily_ = family;
+                std::strncpy(deviceName_, properties.deviceName, sizeof(deviceName_) - 1);
+            }
+            break;
+        }
+    }
+    if (physicalDevice_ == VK_NULL_HANDLE) throw std::runtime_error("No Vulkan device with a compute queue.");
+
+    vk_->vkGetPhysicalDeviceMemoryProperties(physicalDevice_, &memoryProperties_);
+
+    float priority = 1.0f;
+    VkDeviceQueueCreateInfo queueInfo{};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = queueFamily_;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &priority;
+
+    VkDeviceCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.queueCreateInfoCount = 1;
+    createInfo.pQueueCreateInfos = &queueInfo;
+    check(vk_->vkCreateDevice(physicalDevice_, &createInfo, nullptr, &device_), "vkCreateDevice");
+
+#define VULKAN_LOAD_DEVICE_FUNCTION(name) \
+    vk_->name = reinterpret_cast<PFN_##name>(vk_->vkGetDeviceProcAddr(device_, #name)); \
+    if (!vk_->name) throw std::runtime_error(#name " not found.");
+    VULKAN_DEVICE_FUNCTIONS(VULKAN_LOAD_DEVICE_FUNCTION)
+#undef VULKAN_LOAD_DEVICE_FUNCTION
+
+    vk_->vkGetDeviceQueue(device_, queueFamily_, 0, &queue_);
+}
+
+void VulkanBlurRenderer::createPipeline() {
+    // Source, destination and weights
+    VkDescriptorSetLayoutBinding bindings[3]{};
+    for (uint32_t i = 0; i < 3; ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = 3;
+    layoutInfo.pBindings = bindings;
+    check(vk_->vkCreateDescriptorSetLayout(device_, &layoutInfo, nullptr, &descriptorSetLayout_),
+          "vkCreateDescriptorSetLayout");
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.size = sizeof(PassParameters);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout_;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+    check(vk_->vkCreatePipelineLayout(device_, &pipelineLayoutInfo, nullptr, &pipelineLayout_),
+          "vkCreatePipelineLayout");
+
+    VkShaderModuleCreateInfo moduleInfo{};
+    moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    moduleInfo.codeSize = sizeof(kBlurShaderSpirv);
+    moduleInfo.pCode = kBlurShaderSpirv;
+    VkShaderModule shaderModule;
+    check(vk_->vkCreateShaderModule(device_, &moduleInfo, nullptr, &shaderModule), "vkCreateShaderModule");
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout_;
+    VkResult result = vk_->vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline_);
+    vk_->vkDestroyShaderModule(device_, shaderModule, nullptr);
+    check(result, "vkCreateComputePipelines");
+}
+
+void VulkanBlurRenderer::createFrame() {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = 2 * 3;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = 2;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+    check(vk_->vkCreateDescriptorPool(device_, &poolInfo, nullptr, &descriptorPool_), "vkCreateDescriptorPool");
+
+    VkCommandPoolCreateInfo commandPoolInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = queueFamily_;
+    check(vk_->vkCreateCommandPool(device_, &commandPoolInfo, nullptr, &commandPool_), "vkCreateCommandPool");
+
+    VkCommandBufferAllocateInfo commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    commandBufferInfo.commandPool = commandPool_;
+    commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferInfo.commandBufferCount = 1;
+    check(vk_->vkAllocateCommandBuffers(device_, &commandBufferInfo, &frame_.commandBuffer),
+          "vkAllocateCommandBuffers");
+
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    check(vk_->vkCreateFence(device_, &fenceInfo, nullptr, &frame_.fence), "vkCreateFence");
+
+    VkDescriptorSetLayout layouts[2] = {descriptorSetLayout_, descriptorSetLayout_};
+    VkDescriptorSetAllocateInfo setInfo{};
+    setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    setInfo.descriptorPool = descriptorPool_;
+    setInfo.descriptorSetCount = 2;
+    setInfo.pSetLayouts = layouts;
+    check(vk_->vkAllocateDescriptorSets(device_, &setInfo, frame_.descriptorSets), "vkAllocateDescriptorSets");
+}
+
+uint32_t VulkanBlurRenderer::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags) const {
+    for (uint32_t i = 0; i < memoryProperties_.memoryTypeCount; ++i) {
+        if ((typeBits & (1u << i)) && (memoryProperties_.memoryTypes[i].propertyFlags & flags) == flags) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+bool VulkanBlurRenderer::ensureBuffer(Buffer& buffer, VkDeviceSize size, VkMemoryPropertyFlags preferred,
+                                      VkMemoryPropertyFlags required, bool map) {
+    // Buffers only grow, so a steady stream of same sized blurs never reallocates
+    if (buffer.size >= size) return false;
+    destroyBuffer(buffer);
+
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    check(vk_->vkCreateBuffer(device_, &bufferInfo, nullptr, &buffer.buffer), "vkCreateBuffer");
+
+    VkMemoryRequirements requirements;
+    vk_->vkGetBufferMemoryRequirements(device_, buffer.buffer, &requirements);
+
+    uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, preferred | required);
+    if (memoryType == UINT32_MAX) memoryType = findMemoryType(requirements.memoryTypeBits, required);
+    if (memoryType == UINT32_MAX) {
+        vk_->vkDestroyBuffer(device_, buffer.buffer, nullptr);
+        buffer.buffer = VK_NULL_HANDLE;
+        throw std::runtime_error("No suitable Vulkan memory type.");
+    }
+
+    VkMemoryAllocateInfo allocateInfo{};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = requirements.size;
+    allocateInfo.memoryTypeIndex = memoryType;
+    check(vk_->vkAllocateMemory(device_, &allocateInfo, nullptr, &buffer.memory), "vkAllocateMemory");
+    check(vk_->vkBindBufferMemory(device_, buffer.buffer, buffer.memory, 0), "vkBindBufferMemory");
+
+    buffer.size = size;
+    buffer.coherent = (memoryProperties_.memoryTypes[memoryType].propertyFlags &
+                       VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+    if (map) {
+        check(vk_->vkMapMemory(device_, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped), "vkMapMemory");
+    }
+    return true;
+}
+
+void VulkanBlurRenderer::destroyBuffer(Buffer& buffer) {
+    if (buffer.mapped) vk_->vkUnmapMemory(device_, buffer.memory);
+    if (buffer.buffer != VK_NULL_HANDLE) vk_->vkDestroyBuffer(device_, buffer.buffer, nullptr);
+    if (buffer.memory != VK_NULL_HANDLE) vk_->vkFreeMemory(device_, buffer.memory, nullptr);
+    buffer = Buffer();
+}
+
+void VulkanBlurRenderer::updateDescriptorSets(Frame& frame) {
+    // First pass reads the input and writes the intermediate, the second one continues from there
+    VkDescriptorBufferInfo bufferInfos[2][3] = {
+            {{frame.input.buffer, 0, VK_WHOLE_SIZE}, {frame.intermediate.buffer, 0, VK_WHOLE_SIZE},
+             {frame.weights.buffer, 0, VK_WHOLE_SIZE}},
+            {{frame.intermediate.buffer, 0, VK_WHOLE_SIZE}, {frame.output.buffer, 0, VK_WHOLE_SIZE},
+             {frame.weights.buffer, 0, VK_WHOLE_SIZE}},
+    };
+
+    VkWriteDescriptorSet writes[6]{};
+    for (int set = 0; set < 2; ++set) {
+        for (int binding = 0; binding < 3; ++binding) {
+            VkWriteDescriptorSet& write = writes[set * 3 + binding];
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = frame.descriptorSets[set];
+            write.dstBinding = static_cast<uint32_t>(binding);
+            write.descriptorCount = 1;
+            write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            write.pBufferInfo = &bufferInfos[set][binding];
+        }
+    }
+    vk_->vkUpdateDescriptorSets(device_, 6, writes, 0, nullptr);
+}
+
+int VulkanBlurRenderer::calculatePadding(float radius) {
+    return static_cast<int>(std::ceil(radius));
+}
+
+void VulkanBlurRenderer::render(const unsigned char* input, int width, int height, float radius,
+                                BlurEdgeMode edgeMode, unsigned char* output,
+                                int& outputWidth, int& outputHeight) {
+    Frame& frame = frame_;
+
+    bool clampEdges = edgeMode == BlurEdgeMode::Rectangle;
+    int padding = clampEdges ? 0 : calculatePadding(radius);
+    outputWidth = width + 2 * padding;
+    outputHeight = height + 2 * padding;
+
+    // Normalized weights for offsets 0 ... kernelRadius, a radius <= 0.5 is a plain copy
+    int kernelRadius = radius <= 0.5f ? 0 : static_cast<int>(std::ceil(radius));
+    std::vector<float> weights(kernelRadius + 1, 0.0f);
+    weights[0] = 1.0f;
+    if (kernelRadius > 0) {
+        float sigma = radius / 2.0f;
+        float twoSigmaSq = 2.0f * sigma * sigma;
+        float totalWeight = 1.0f;
+        for (int k = 1; k <= kernelRadius; ++k) {
+            if (static_cast<float>(k) <= radius) {
+                weights[k] = std::exp(-static_cast<float>(k * k) / twoSigmaSq);
+                totalWeight += 2.0f * weights[k];
+            }
+        }
+        for (float& weight : weights) weight /= totalWeight;
+    }
+
+    VkDeviceSize inputBytes = static_cast<VkDeviceSize>(width) * height * 4;
+    VkDeviceSize intermediateBytes = static_cast<VkDeviceSize>(outputWidth) * height * 4;
+    VkDeviceSize outputBytes = static_cast<VkDeviceSize>(outputWidth) * outputHeight * 4;
+    VkDeviceSize weightBytes = weights.size() * sizeof(float);
+
+    // A recreated buffer can come back with the handle of the one it replaced, so whether the
+    // descriptors are stale is tracked by reallocation rather than by comparing handles
+    bool reallocated = ensureBuffer(frame.input, inputBytes, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
+    reallocated |= ensureBuffer(frame.intermediate, intermediateBytes, 0,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, false);
+    reallocated |= ensureBuffer(frame.output, outputBytes, VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
+    reallocated |= ensureBuffer(frame.weights, weightBytes, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, true);
+    if (reallocated) {
+        updateDescriptorSets(frame);
+    }
+
+    std::memcpy(frame.input.mapped, input, inputBytes);
+    std::memcpy(frame.weights.mapped, weights.data(), weightBytes);
+    VkMappedMemoryRange flushRanges[2] = {
+            {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, frame.input.memory, 0, VK_WHOLE_SIZE},
+            {VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, frame.weights.memory, 0, VK_WHOLE_SIZE},
+    };
+    if (!frame.input.coherent) vk_->vkFlushMappedMemoryRanges(device_, 1, &flushRanges[0]);
+    if (!frame.weights.coherent) vk_->vkFlushMappedMemoryRanges(device_, 1, &flushRanges[1]);
+
+    VkCommandBuffer commandBuffer = frame.commandBuffer;
+    vk_->vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    check(vk_->vkBeginCommandBuffer(commandBuffer, &beginInfo), "vkBeginCommandBuffer");
+
+    vk_->vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_);
+
+    // Horizontal pass: rows of the input into the intermediate, transposed to outputWidth rows of height
+    PassParameters horizontal{width, height, outputWidth, padding, kernelRadius, clampEdges ? 1 : 0};
+    vk_->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1,
+                                 &frame.descriptorSets[0], 0, nullptr);
+    vk_->vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                            sizeof(horizontal), &horizontal);
+    vk_->vkCmdDispatch(commandBuffer, (outputWidth + kGroupSize - 1) / kGroupSize, height, 1);
+
+    VkMemoryBarrier passBarrier{};
+    passBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    passBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    passBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vk_->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &passBarrier, 0, nullptr, 0, nullptr);
+
+    // Vertical pass: rows of the intermediate are input columns, transposed back into the output
+    PassParameters vertical{height, outputWidth, outputHeight, padding, kernelRadius, clampEdges ? 1 : 0};
+    vk_->vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout_, 0, 1,
+                                 &frame.descriptorSets[1], 0, nullptr);
+    vk_->vkCmdPushConstants(commandBuffer, pipelineLayout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                            sizeof(vertical), &vertical);
+    vk_->vkCmdDispatch(commandBuffer, (outputHeight + kGroupSize - 1) / kGroupSize, outputWidth, 1);
+
+    VkMemoryBarrier readbackBarrier{};
+    readbackBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    readbackBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vk_->vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                              VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &readbackBarrier, 0, nullptr, 0, nullptr);
+
+    check(vk_->vkEndCommandBuffer(commandBuffer), "vkEndCommandBuffer");
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    check(vk_->vkResetFences(device_, 1, &frame.fence), "vkResetFences");
+    check(vk_->vkQueueSubmit(queue_, 1, &submitInfo, frame.fence), "vkQueueSubmit");
+    check(vk_->vkWaitForFences(device_, 1, &frame.fence, VK_TRUE, UINT64_MAX), "vkWaitForFences");
+
+    if (!frame.output.coherent) {
+        VkMappedMemoryRange range{VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr, frame.output.memory,
+                                  0, VK_WHOLE_SIZE};
+        vk_->vkInvalidateMappedMemoryRanges(device_, 1, &range);
+    }
+    std::memcpy(output, frame.output.mapped, static_cast<size_t>(outputBytes));
+}
@@ -0,0 +1,90 @@
+#ifndef VULKAN_BLUR_H
+#define VULKAN_BLUR_H
+
+#define VK_NO_PROTOTYPES
+#include <vulkan/vulkan.h>
+#include <memory>
+#include "blur_edge_mode.h"
+
+struct VulkanFunctions;
+
+// Vulkan compute implementation of the same separable Gaussian the GL renderers use
+// (sigma = radius / 2, taps up to |x| <= radius), on tightly packed RGBA8888 pixels.
+// Each pass blurs rows through a shared memory tile and writes its result transposed, so the
+// vertical pass reads rows too. Input and output live in host visible buffers, so there is no
+// separate upload or readback copy.
+//
+// Blurs run one at a time, like every blur on the render thread, through one set of buffers
+// that grows to the largest blur so far.
+class VulkanBlurRenderer {
+public:
+    // Loads libvulkan and creates a device with a compute queue.
+    // Throws std::runtime_error when Vulkan isn't available.
+    VulkanBlurRenderer();
+    ~VulkanBlurRenderer();
+
+    VulkanBlurRenderer(const VulkanBlurRenderer&) = delete;
+    VulkanBlurRenderer& operator=(const VulkanBlurRenderer&) = delete;
+
+    // Blocks until the blur is done. Unbounded output grows by calculatePadding(radius) on every side.
+    void render(const unsigned char* input, int width, int height, float radius, BlurEdgeMode edgeMode,
+                unsigned char* output, int& outputWidth, int& outputHeight);
+
+    // Same padding as CpuBlurRenderer
+    static int calculatePadding(float radius);
+
+    const char* deviceName() const { return deviceName_; }
+
+private:
+    struct Buffer {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        void* mapped = nullptr;
+        bool coherent = true;
+    };
+
+    // Command buffer, fence and buffers the blurs are recorded and run with
+    struct Frame {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSets[2] = {VK_NULL_HANDLE, VK_NULL_HANDLE};
+        Buffer input;
+        Buffer intermediate;
+        Buffer output;
+        Buffer weights;
+    };
+
+    void createInstance();
+    void createDevice();
+    void createPipeline();
+    void createFrame();
+    void release();
+
+    bool ensureBuffer(Buffer& buffer, VkDeviceSize size, VkMemoryPropertyFlags preferred,
+                      VkMemoryPropertyFlags required, bool map);
+    void destroyBuffer(Buffer& buffer);
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags flags) const;
+    void updateDescriptorSets(Frame& frame);
+
+    void* library_;
+    std::unique_ptr<VulkanFunctions> vk_;
+
+    VkInstance instance_;
+    VkPhysicalDevice physicalDevice_;
+    VkPhysicalDeviceMemoryProperties memoryProperties_;
+    VkDevice device_;
+    VkQueue queue_;
+    uint32_t queueFamily_;
+    char deviceName_[VK_MAX_PHYSICAL_DEVICE_NAME_SIZE];
+
+    VkDescriptorSetLayout descriptorSetLayout_;
+    VkPipelineLayout pipelineLayout_;
+    VkPipeline pipeline_;
+    VkDescriptorPool descriptorPool_;
+    VkCommandPool commandPool_;
+
+    Frame frame_;
+};
+
+#endif // VULKAN_BLUR_H
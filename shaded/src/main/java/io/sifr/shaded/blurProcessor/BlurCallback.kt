@@ -0,0 +1,21 @@
+package io.sifr.shaded.blurProcessor
+
+import android.graphics.Bitmap
+
+internal fun interface BlurCallback {
+    /**
+     * [outcome] is one of the outcome constants below, [result] is only set for [COMPLETED].
+     */
+    fun onBlurComplete(result: Bitmap?, outcome: Int)
+
+    companion object {
+        const val COMPLETED = 0
+        const val FAILED = 1
+
+        /** A newer blur of the same surface replaced this one before it started */
+        const val COALESCED = 2
+
+        /** The deadline passed before the blur could start */
+        const val EXPIRED = 3
+    }
+}
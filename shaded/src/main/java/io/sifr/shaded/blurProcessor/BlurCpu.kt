@@ -0,0 +1,37 @@
+package io.sifr.shaded.blurProcessor
+
+import android.graphics.Bitmap
+
+/**
+ * Multi-threaded CPU implementation of the same blur [BlurNative] renders with OpenGL.
+ * Useful where no GL context is available or the GPU is busy with app rendering.
+ */
+internal object BlurCpu: BlurProcessor {
+    init {
+        System.loadLibrary("blur_renderer")
+    }
+
+    private external fun blurBitmap(bitmap: Bitmap, radius: Float): Bitmap
+    private external fun blurBitmapUnbounded(bitmap: Bitmap, radius: Float): Bitmap
+
+    /**
+     * Blurs a synthetic [width] x [height] image with one thread up to one thread per core
+     * and returns the timings together with the speedup and parallel efficiency of each run.
+     */
+    external fun benchmarkScaling(width: Int, height: Int, radius: Float): String
+
+    /**
+     * Blurs the raw RGBA_8888 pixels in [inputPath] into [outputPath] a band of rows at a time,
+     * without loading the image. Returns false if either file couldn't be used.
+     */
+    external fun blurRawFile(
+        inputPath: String, width: Int, height: Int, radius: Float, edgeTreatment: Int, outputPath: String
+    ): Boolean
+
+    override fun blurBitmap(inputBitmap: Bitmap, radius: Float, blurEdgeTreatment: BlurEdgeTreatment): Bitmap {
+        return when (blurEdgeTreatment) {
+            BlurEdgeTreatment.RECTANGLE -> blurBitmap(inputBitmap, radius)
+            BlurEdgeTreatment.UNBOUNDED -> blurBitmapUnbounded(inputBitmap, radius)
+        }
+    }
+}
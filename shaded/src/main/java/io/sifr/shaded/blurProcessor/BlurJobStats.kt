@@ -0,0 +1,16 @@
+package io.sifr.shaded.blurProcessor
+
+/**
+ * Counters of the blurs the blur modifier queued, see [ShadedBlur.blurJobStats].
+ *
+ * @property submitted Blurs queued so far
+ * @property started Blurs that were rendered
+ * @property coalesced Blurs replaced by a newer one of the same node before they started
+ * @property expired Blurs dropped because they couldn't start before their deadline
+ */
+data class BlurJobStats(
+    val submitted: Long,
+    val started: Long,
+    val coalesced: Long,
+    val expired: Long
+)
@@ -9,6 +9,60 @@ internal object BlurNative: BlurProcessor {
 
     private external fun blurBitmap(bitmap: Bitmap, radius: Float): Bitmap
     private external fun blurBitmapUnbounded(bitmap: Bitmap, radius: Float): Bitmap
+    private external fun blurBitmapAsync(
+        bitmap: Bitmap, radius: Float, edgeTreatment: Int, surfaceId: Long, deadlineNanos: Long, callback: BlurCallback
+    )
+
+    /**
+     * Rectangle blur of scrolling content. [frameKey] identifies the scrolling surface, and
+     * [scrollX] / [scrollY] say how many pixels its content moved up / left since its previous
+     * frame was blurred. Only the newly exposed strips are blurred again, the rest of the previous
+     * result is reused, so the cost follows scroll speed instead of surface size.
+     */
+    external fun blurBitmapScrolled(bitmap: Bitmap, radius: Float, frameKey: Long, scrollX: Int, scrollY: Int): Bitmap
+
+    /**
+     * Creates the EGL contexts and compiles the blur programs on a background thread,
+     * so the first blurred frame doesn't pay for it.
+     */
+    external fun prewarm()
+
+    /**
+     * Points the persistent cache of blurred results at [directory], or turns it off when
+     * [directory] is null or [maxBytes] is not positive.
+     */
+    external fun setDiskCache(directory: String?, maxBytes: Long)
+
+    /**
+     * Routes RGBA8888 blurs through the Vulkan compute renderer instead of GL when [enabled].
+     * Returns whether Vulkan is actually used, which is false when the device or the build has no
+     * Vulkan support.
+     */
+    external fun setVulkanEnabled(enabled: Boolean): Boolean
+
+    /**
+     * Splits full resolution ARGB_8888 rectangle blurs by rows between the GPU and CPU when
+     * [enabled], sized by the throughput measured for each.
+     */
+    external fun setHybridEnabled(enabled: Boolean)
+
+    /**
+     * Renders ARGB_8888 rectangle blurs into hardware buffers returned as hardware bitmaps when
+     * [enabled], skipping the readback. Needs API 29. Returns whether it is used, which is false
+     * when the device can't share buffers between GL and bitmaps.
+     */
+    external fun setZeroCopyEnabled(enabled: Boolean): Boolean
+
+    /**
+     * Chrome trace event JSON of the latest blur calls kept by the native flight recorder.
+     */
+    external fun dumpTrace(): String
+
+    /**
+     * Pixels the unbounded blur grows its input by on each side, the area it covers once drawn.
+     * Results of large radii are rendered at a fraction of that and have to be drawn scaled up to it.
+     */
+    external fun unboundedPadding(radius: Float): Int
 
     override fun blurBitmap(inputBitmap: Bitmap, radius: Float, blurEdgeTreatment: BlurEdgeTreatment): Bitmap {
         return when (blurEdgeTreatment) {
@@ -16,4 +70,29 @@ internal object BlurNative: BlurProcessor {
             BlurEdgeTreatment.UNBOUNDED -> blurBitmapUnbounded(inputBitmap, radius)
         }
     }
-}
\ No newline at end of file
+
+    /**
+     * Queues the blur for the native render thread and returns immediately. [callback] is invoked
+     * on the render thread with the result and its outcome. Like [blurBitmap], the rectangle
+     * treatment blurs [inputBitmap] in place, so it must not be used until then.
+     *
+     * Only the newest waiting blur of a [surfaceId] runs, older ones end as coalesced. Blurs that
+     * can't start before [deadlineNanos] (in [System.nanoTime] time) end as expired, and among
+     * waiting blurs the earliest deadline starts first.
+     */
+    fun blurBitmapAsync(
+        inputBitmap: Bitmap,
+        radius: Float,
+        blurEdgeTreatment: BlurEdgeTreatment,
+        surfaceId: Long,
+        deadlineNanos: Long,
+        callback: BlurCallback
+    ) {
+        blurBitmapAsync(inputBitmap, radius, blurEdgeTreatment.ordinal, surfaceId, deadlineNanos, callback)
+    }
+
+    /**
+     * Counters of the async blurs so far: submitted, started, coalesced and expired.
+     */
+    external fun blurJobStats(): LongArray
+}
@@ -0,0 +1,183 @@
+package io.sifr.shaded.blurProcessor
+
+import android.graphics.Bitmap
+import android.os.Build
+import java.io.File
+
+/**
+ * Entry points for tuning the blur engine used by [io.sifr.shaded.modifiers.blur] below Android 12.
+ */
+object ShadedBlur {
+
+    /**
+     * Starts setting up the blur engine in the background, ideally early in app startup.
+     * Without it the setup cost is paid by the first blurred frame.
+     *
+     * Does nothing on Android 12 and above, where the platform blur is used instead.
+     */
+    fun prewarm() {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.prewarm()
+        }
+    }
+
+    /**
+     * Keeps blurred results in [directory] across app launches, so blurring the same content
+     * with the same radius and edge treatment again is a file copy instead of a render.
+     * Least recently used entries are dropped once the cache grows past [maxBytes].
+     *
+     * Best suited for content that is blurred repeatedly, like the same remote thumbnails in a feed.
+     * Does nothing on Android 12 and above, where the platform blur is used instead.
+     */
+    fun enableDiskCache(directory: File, maxBytes: Long = DEFAULT_DISK_CACHE_BYTES) {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.setDiskCache(directory.absolutePath, maxBytes)
+        }
+    }
+
+    fun disableDiskCache() {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.setDiskCache(null, 0)
+        }
+    }
+
+    /**
+     * Blurs ARGB_8888 bitmaps with Vulkan compute instead of GL where the device supports it.
+     * Returns false, and keeps using GL, when Vulkan isn't available.
+     *
+     * Does nothing on Android 12 and above, where the platform blur is used instead.
+     */
+    fun enableVulkan(): Boolean {
+        return Build.VERSION.SDK_INT < Build.VERSION_CODES.S && BlurNative.setVulkanEnabled(true)
+    }
+
+    fun disableVulkan() {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.setVulkanEnabled(false)
+        }
+    }
+
+    /**
+     * Shares each rectangle blur between the GPU and idle CPU cores. The split adapts to how fast
+     * each side turned out to be, down to leaving one side out entirely, which helps on devices
+     * where app rendering keeps the GPU busy.
+     *
+     * Does nothing on Android 12 and above, where the platform blur is used instead.
+     */
+    fun enableHybridBlur() {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.setHybridEnabled(true)
+        }
+    }
+
+    fun disableHybridBlur() {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.setHybridEnabled(false)
+        }
+    }
+
+    /**
+     * Hands rectangle blurs out as hardware bitmaps the GPU rendered into directly, instead of
+     * copying every result back into a regular bitmap. Saves the most on large surfaces. Results
+     * can then only be drawn, not read or modified. Returns false when that isn't supported, then
+     * results keep being copied back.
+     *
+     * Only available on Android 10 and 11, below that there are no hardware bitmaps to wrap the
+     * results in, and above that the platform blur is used instead.
+     */
+    fun enableZeroCopyOutput(): Boolean {
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q && Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            return BlurNative.setZeroCopyEnabled(true)
+        }
+        return false
+    }
+
+    fun disableZeroCopyOutput() {
+        if (Build.VERSION.SDK_INT >= Build.VERSION_CODES.Q && Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            BlurNative.setZeroCopyEnabled(false)
+        }
+    }
+
+    /**
+     * The latest blur calls (up to 512) as Chrome trace event JSON, which opens in Perfetto or
+     * chrome://tracing. Each call shows its size, radius, backend and cache outcome, with its
+     * upload, render and readback stages on the threads that ran them. Recording is always on,
+     * so this can be attached to jank reports after the fact.
+     *
+     * Returns an empty trace on Android 12 and above, where the platform blur is used instead.
+     */
+    fun dumpTrace(): String {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            return BlurNative.dumpTrace()
+        }
+        return EMPTY_TRACE
+    }
+
+    /**
+     * How many blurs [io.sifr.shaded.modifiers.blur] asked for so far, and what became of them.
+     * Blurs that were replaced by a newer one of the same node, or that couldn't start before
+     * their frame deadline, never reach the GPU. Under load they show up as coalesced or expired
+     * instead of started.
+     *
+     * All zero on Android 12 and above, where the platform blur is used instead.
+     */
+    fun blurJobStats(): BlurJobStats {
+        if (Build.VERSION.SDK_INT < Build.VERSION_CODES.S) {
+            val counters = BlurNative.blurJobStats()
+            return BlurJobStats(
+                submitted = counters[0],
+                started = counters[1],
+                coalesced = counters[2],
+                expired = counters[3]
+            )
+        }
+        return BlurJobStats(0, 0, 0, 0)
+    }
+
+    /**
+     * Blurs an image too large to load as a bitmap, like a panorama or a scan. [input] holds
+     * [width] x [height] raw RGBA_8888 pixels, row after row without gaps, and [output] receives
+     * the blurred pixels in the same layout. The unbounded edge treatment grows the output by
+     * [unboundedPadding] on every side.
+     *
+     * Rows are read and written as the blur goes, memory use depends on [width] and [radius] only.
+     * Runs on the calling thread, so call it from a background one. Returns false if [input]
+     * couldn't be read, doesn't hold [width] x [height] pixels, or [output] couldn't be written.
+     * Available on every Android version.
+     */
+    fun blurRawFile(
+        input: File,
+        width: Int,
+        height: Int,
+        radius: Float,
+        output: File,
+        edgeTreatment: BlurEdgeTreatment = BlurEdgeTreatment.RECTANGLE
+    ): Boolean {
+        return BlurCpu.blurRawFile(
+            input.absolutePath, width, height, radius, edgeTreatment.ordinal, output.absolutePath
+        )
+    }
+
+    /**
+     * Rectangle blur of a frame of scrolling content, like a snapshot of a list behind a frosted
+     * toolbar, in place. [frameKey] identifies the scrolling surface, and [scrollX] / [scrollY]
+     * are how many pixels it scrolled since its previous frame went through here, i.e. how far
+     * its content moved left / up. Only the newly exposed strips are blurred again and the rest
+     * of the previous result is reused, so the cost follows scroll speed instead of surface size.
+     * Whenever the content changed in any other way than scrolling, pass a new [frameKey] so the
+     * whole frame is blurred again.
+     *
+     * Blocks until the blur is done. Available on every Android version.
+     */
+    fun blurScrolled(bitmap: Bitmap, radius: Float, frameKey: Long, scrollX: Int, scrollY: Int): Bitmap {
+        return BlurNative.blurBitmapScrolled(bitmap, radius, frameKey, scrollX, scrollY)
+    }
+
+    /**
+     * Pixels the unbounded edge treatment of [blurRawFile] adds on each side of the image.
+     */
+    fun unboundedPadding(radius: Float): Int = BlurNative.unboundedPadding(radius)
+
+    private const val EMPTY_TRACE = "{\"traceEvents\":[]}"
+    private const val DEFAULT_DISK_CACHE_BYTES = 32L * 1024 * 1024
+}
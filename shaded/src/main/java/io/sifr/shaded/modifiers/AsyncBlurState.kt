@@ -0,0 +1,119 @@
+package io.sifr.shaded.modifiers
+
+import android.graphics.Bitmap
+import android.os.Handler
+import android.os.Looper
+import androidx.compose.runtime.mutableIntStateOf
+import io.sifr.shaded.blurProcessor.BlurCallback
+import io.sifr.shaded.blurProcessor.BlurEdgeTreatment
+import io.sifr.shaded.blurProcessor.BlurNative
+
+/**
+ * A finished blur together with what it was made from. Large radii come back downscaled,
+ * so drawing needs the source size to scale the bitmap back up.
+ */
+internal class BlurResult(
+    val bitmap: Bitmap,
+    val sourceWidth: Int,
+    val sourceHeight: Int,
+    val radius: Float
+)
+
+/**
+ * Keeps the blur of one node off the UI thread. Frames draw the latest finished result while
+ * the next blur runs on the native render thread, only the very first frame blurs synchronously
+ * because there is nothing to show yet.
+ *
+ * Every frame hands its blur to the native scheduler under this node's surface ID, which only
+ * starts the newest one and drops those that waited past their deadline.
+ *
+ * Only touched from the main thread.
+ */
+internal class AsyncBlurState {
+    private val mainHandler = Handler(Looper.getMainLooper())
+
+    /** Read while drawing, so a finished blur invalidates the draw */
+    val completedBlurs = mutableIntStateOf(0)
+
+    var latest: BlurResult? = null
+        private set
+
+    private val surfaceId = nextSurfaceId++
+    private var inFlight = 0
+    private var redrawForResult = false
+    private var released = false
+
+    /**
+     * Takes ownership of [bitmap] and blurs it. Blurs submitted before it that haven't started
+     * yet are replaced by it.
+     */
+    fun submit(bitmap: Bitmap, radius: Float, edgeTreatment: BlurEdgeTreatment) {
+        if (latest == null && inFlight == 0) {
+            val sourceWidth = bitmap.width
+            val sourceHeight = bitmap.height
+            val blurred = BlurNative.blurBitmap(bitmap, radius, edgeTreatment)
+            if (blurred !== bitmap) bitmap.recycle()
+            latest = BlurResult(blurred, sourceWidth, sourceHeight, radius)
+            return
+        }
+
+        inFlight++
+        val sourceWidth = bitmap.width
+        val sourceHeight = bitmap.height
+        val deadline = System.nanoTime() + MAX_START_DELAY_NANOS
+        BlurNative.blurBitmapAsync(bitmap, radius, edgeTreatment, surfaceId, deadline) { result, outcome ->
+            mainHandler.post {
+                onComplete(bitmap, result?.let { BlurResult(it, sourceWidth, sourceHeight, radius) }, outcome)
+            }
+        }
+    }
+
+    /**
+     * Whether the current draw was only triggered by a finished blur. Such draws reuse the
+     * result instead of recording the content again, which would start yet another blur.
+     */
+    fun consumeResultRedraw(): Boolean {
+        val result = redrawForResult
+        redrawForResult = false
+        return result
+    }
+
+    fun release() {
+        released = true
+        latest?.bitmap?.recycle()
+        latest = null
+    }
+
+    private fun onComplete(input: Bitmap, result: BlurResult?, outcome: Int) {
+        inFlight--
+
+        if (result?.bitmap !== input) input.recycle()
+
+        if (released) {
+            result?.bitmap?.recycle()
+            return
+        }
+
+        when (outcome) {
+            BlurCallback.COMPLETED -> if (result != null) {
+                latest?.bitmap?.recycle()
+                latest = result
+                redrawForResult = true
+                completedBlurs.intValue++
+            }
+
+            // The content it was made from is stale by now. Unless a newer blur is on its way,
+            // draw again so the current content gets recorded and blurred.
+            BlurCallback.EXPIRED -> if (inFlight == 0) completedBlurs.intValue++
+
+            // Coalesced blurs were replaced by a newer one, failed ones keep the latest result
+        }
+    }
+
+    private companion object {
+        /** Blurs that couldn't start within a few frames of being asked for are dropped */
+        const val MAX_START_DELAY_NANOS = 100_000_000L
+
+        var nextSurfaceId = 0L
+    }
+}
@@ -1,7 +1,10 @@
 package io.sifr.shaded.modifiers
 
+import android.graphics.Paint
 import android.graphics.Picture
+import android.graphics.RectF
 import android.os.Build
+import androidx.compose.runtime.DisposableEffect
 import androidx.compose.runtime.NonRestartableComposable
 import androidx.compose.runtime.remember
 import androidx.compose.ui.Modifier
@@ -43,24 +46,31 @@ fun Modifier.blur(
 } else {
     composed {
         val picture = remember { Picture() }
+        val blurState = remember { AsyncBlurState() }
 
-        val blurPadding = if (edgeTreatment == BlurEdgeTreatment.UNBOUNDED) {
-            (radius * 4f).toInt()
-        } else {
-            0
+        DisposableEffect(blurState) {
+            onDispose { blurState.release() }
         }
 
         this.drawWithCache {
             val originalWidth = this.size.width.toInt()
             val originalHeight = this.size.height.toInt()
 
+            // Large radii come back downscaled, filter when scaling them up again
+            val scalingPaint = Paint(Paint.FILTER_BITMAP_FLAG)
+            val destination = RectF()
+
             onDrawWithContent {
                 if (originalWidth > 0 && originalHeight > 0) {
+                    // Reading the counter makes a finished blur redraw this node
+                    blurState.completedBlurs.intValue
 
-                    val originalBitmap = recordComposable(picture, this@drawWithCache)
+                    if (!blurState.consumeResultRedraw()) {
+                        val originalBitmap = recordComposable(picture, this@drawWithCache)
+                        blurState.submit(originalBitmap, radius * 4f, edgeTreatment)
+                    }
 
-                    val blurredBitmap =
-                        BlurNative.blurBitmap(originalBitmap, radius * 4f, edgeTreatment)
+                    val result = blurState.latest ?: return@onDrawWithContent
 
                     drawIntoCanvas { canvas ->
                         when (edgeTreatment) {
@@ -68,26 +78,28 @@ fun Modifier.blur(
                                 canvas.nativeCanvas.clipRect(
                                     0f, 0f, originalWidth.toFloat(), originalHeight.toFloat()
                                 )
+                                destination.set(
+                                    0f, 0f, result.sourceWidth.toFloat(), result.sourceHeight.toFloat()
+                                )
                                 canvas.nativeCanvas.drawBitmap(
-                                    blurredBitmap, 0f, 0f, null
+                                    result.bitmap, null, destination, scalingPaint
                                 )
                             }
 
                             BlurEdgeTreatment.UNBOUNDED -> {
+                                // The result may still be from a previous size or radius while the
+                                // next one is in flight, so lay it out from what it was made of
+                                val padding = BlurNative.unboundedPadding(result.radius).toFloat()
+                                destination.set(
+                                    -padding, -padding,
+                                    result.sourceWidth + padding, result.sourceHeight + padding
+                                )
                                 canvas.nativeCanvas.drawBitmap(
-                                    blurredBitmap,
-                                    -blurPadding.toFloat(),
-                                    -blurPadding.toFloat(),
-                                    null
+                                    result.bitmap, null, destination, scalingPaint
                                 )
                             }
                         }
                     }
-
-                    if (blurredBitmap != originalBitmap) {
-                        blurredBitmap.recycle()
-                    }
-                    originalBitmap.recycle()
                 }
             }
         }
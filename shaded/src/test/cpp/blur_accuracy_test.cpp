@@ -0,0 +1,433 @@
+#include "cpu_blur.h"
+#include "hybrid_blur.h"
+#include "reference_blur.h"
+#include "streaming_blur.h"
+#include "test_support.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if SHADED_HARNESS_GL
+#include "blur_renderer.h"
+#include "readback_scale.h"
+#include "shared_image.h"
+#include "unbounded_blur.h"
+#endif
+#if SHADED_HARNESS_VULKAN
+#include "vulkan_blur.h"
+#endif
+
+// Runs every available backend over a corpus of synthetic images and radii, compares each result
+// with the double precision reference and reports PSNR and max channel error next to time per
+// megapixel. Fails when a mode goes past its error budget below.
+//
+// Downscaled modes are scaled back up bilinearly to the size they are drawn at before comparing,
+// like the modifier does.
+
+namespace {
+    struct Budget {
+        const char* mode;
+        double minPsnr;
+        int maxError;
+    };
+
+    // Error budgets per mode (backend / edge treatment). Tighten them when a change makes a mode more
+    // accurate, loosening one has to be a deliberate trade for speed.
+    const Budget kBudgets[] = {
+            {"cpu/rectangle",           50.0, 2},
+            {"cpu/unbounded",           50.0, 2},
+            {"hybrid/rectangle",        56.0, 2},
+            {"streaming/rectangle",     50.0, 2},
+            {"streaming/unbounded",     50.0, 2},
+            {"gl/rectangle",            56.0, 2},
+            {"gl/unbounded",            56.0, 2},
+            {"gl-shared/rectangle",     56.0, 2},
+            {"gl-downscaled/rectangle", 42.0, 16},
+            {"gl-downscaled/unbounded", 44.0, 6},
+            {"vulkan/rectangle",        50.0, 2},
+            {"vulkan/unbounded",        50.0, 2},
+    };
+
+    const float kRadii[] = {0.3f, 0.75f, 1.0f, 2.0f, 3.5f, 8.0f, 24.0f, 60.0f};
+
+    struct Image {
+        const char* name;
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+
+    // What a backend produced: pixels at 1 / downscale of the full result, which is the input
+    // grown by padding on every side.
+    struct BlurOutput {
+        int width = 0;
+        int height = 0;
+        int padding = 0;
+        std::vector<unsigned char> pixels;
+    };
+
+    struct Backend {
+        std::string name;
+        std::function<bool(const Image& input, float radius, BlurEdgeMode edgeMode, BlurOutput& output)> blur;
+    };
+
+    struct ModeResult {
+        double worstPsnr = 1e9;
+        int worstError = 0;
+        double milliseconds = 0.0;
+        double megapixels = 0.0;
+    };
+
+    // Premultiplied RGBA8888 like bitmap pixels
+    void setPixel(Image& image, int x, int y, double r, double g, double b, double a) {
+        unsigned char* pixel = &image.pixels[(static_cast<size_t>(y) * image.width + x) * 4];
+        pixel[0] = static_cast<unsigned char>(std::lround(r * a * 255.0));
+        pixel[1] = static_cast<unsigned char>(std::lround(g * a * 255.0));
+        pixel[2] = static_cast<unsigned char>(std::lround(b * a * 255.0));
+        pixel[3] = static_cast<unsigned char>(std::lround(a * 255.0));
+    }
+
+    std::vector<Image> makeCorpus() {
+        const int width = 193, height = 127;
+        std::vector<Image> corpus;
+        auto add = [&](const char* name, const std::function<void(Image&, int, int)>& fill) {
+            Image image{name, width, height, std::vector<unsigned char>(static_cast<size_t>(width) * height * 4)};
+            for (int y = 0; y < height; ++y) {
+                for (int x = 0; x < width; ++x) fill(image, x, y);
+            }
+            corpus.push_back(std::move(image));
+        };
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        add("noise", [&](Image& image, int x, int y) {
+            setPixel(image, x, y, unit(random), unit(random), unit(random), unit(random));
+        });
+        add("gradient", [&](Image& image, int x, int y) {
+            setPixel(image, x, y, x / (width - 1.0), y / (height - 1.0), 1.0 - x / (width - 1.0), 1.0);
+        });
+        add("checker", [&](Image& image, int x, int y) {
+            double value = ((x / 8) + (y / 8)) % 2 == 0 ? 1.0 : 0.0;
+            setPixel(image, x, y, value, value, value, 1.0);
+        });
+        add("disc", [&](Image& image, int x, int y) {
+            double dx = x - width / 2.0, dy = y - height / 2.0;
+            double inside = dx * dx + dy * dy <= 50.0 * 50.0 ? 1.0 : 0.0;
+            setPixel(image, x, y, 0.9, 0.3, 0.1, inside);
+        });
+        add("lines", [&](Image& image, int x, int y) {
+            double ink = (y % 12 < 2 || x % 17 == 0) ? 1.0 : 0.0;
+            setPixel(image, x, y, 1.0 - ink, 1.0 - ink, 1.0 - ink, 1.0);
+        });
+        return corpus;
+    }
+
+    // Bilinear resize of a downscaled result to the size it is drawn at
+    std::vector<double> scaleTo(const BlurOutput& output, int width, int height) {
+        std::vector<double> scaled(static_cast<size_t>(width) * height * 4);
+        auto sample = [&](int x, int y, int c) {
+            x = std::min(std::max(x, 0), output.width - 1);
+            y = std::min(std::max(y, 0), output.height - 1);
+            return static_cast<double>(output.pixels[(static_cast<size_t>(y) * output.width + x) * 4 + c]);
+        };
+        for (int y = 0; y < height; ++y) {
+            double v = (y + 0.5) * output.height / height - 0.5;
+            int y0 = static_cast<int>(std::floor(v));
+            double fy = v - y0;
+            for (int x = 0; x < width; ++x) {
+                double u = (x + 0.5) * output.width / width - 0.5;
+                int x0 = static_cast<int>(std::floor(u));
+                double fx = u - x0;
+                for (int c = 0; c < 4; ++c) {
+                    double top = sample(x0, y0, c) * (1.0 - fx) + sample(x0 + 1, y0, c) * fx;
+                    double bottom = sample(x0, y0 + 1, c) * (1.0 - fx) + sample(x0 + 1, y0 + 1, c) * fx;
+                    scaled[(static_cast<size_t>(y) * width + x) * 4 + c] = top * (1.0 - fy) + bottom * fy;
+                }
+            }
+        }
+        return scaled;
+    }
+
+    // Backends that were built in but couldn't run on this host are added to skipped
+    std::vector<Backend> makeBackends(std::vector<std::string>& skipped) {
+        std::vector<Backend> backends;
+        int threadCount = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+
+        auto cpu = std::make_shared<CpuBlurRenderer>(threadCount);
+        backends.push_back({"cpu", [cpu](const Image& input, float radius, BlurEdgeMode edgeMode, BlurOutput& output) {
+            int padding = edgeMode == BlurEdgeMode::Rectangle ? 0 : CpuBlurRenderer::calculatePadding(radius);
+            output.padding = padding;
+            output.pixels.resize(static_cast<size_t>(input.width + 2 * padding) * (input.height + 2 * padding) * 4);
+            if (edgeMode == BlurEdgeMode::Rectangle) {
+                output.width = input.width;
+                output.height = input.height;
+                cpu->render(input.pixels.data(), input.width, input.height, radius, output.pixels.data());
+            } else {
+                cpu->renderUnbounded(input.pixels.data(), input.width, input.height, radius, output.pixels.data(),
+                                     output.width, output.height);
+            }
+            return true;
+        }});
+
+        // Rows handed over one at a time, as from a file too large to load
+        auto streaming = std::make_shared<StreamingBlurRenderer>(threadCount);
+        backends.push_back({"streaming", [streaming](const Image& input, float radius, BlurEdgeMode edgeMode,
+                                                     BlurOutput& output) {
+            output.padding = StreamingBlurRenderer::calculatePadding(radius, edgeMode);
+            output.width = input.width + 2 * output.padding;
+            output.height = input.height + 2 * output.padding;
+            output.pixels.resize(static_cast<size_t>(output.width) * output.height * 4);
+            size_t inputRowBytes = static_cast<size_t>(input.width) * 4;
+            size_t outputRowBytes = static_cast<size_t>(output.width) * 4;
+            streaming->render(input.width, input.height, radius, edgeMode,
+                              [&](int y, unsigned char* scratch) -> const unsigned char* {
+                                  std::memcpy(scratch, input.pixels.data() + y * inputRowBytes, inputRowBytes);
+                                  return scratch;
+                              },
+                              [&](int y, const unsigned char* row) {
+                                  std::memcpy(output.pixels.data() + y * outputRowBytes, row, outputRowBytes);
+                              });
+            return true;
+        }});
+
+#if SHADED_HARNESS_GL
+        std::shared_ptr<BlurRenderer> rectangle;
+        std::shared_ptr<UnboundedBlurRenderer> unbounded;
+        try {
+            rectangle = std::make_shared<BlurRenderer>(200, 200);
+            rectangle->initialize();
+            unbounded = std::make_shared<UnboundedBlurRenderer>(200, 200);
+            unbounded->initialize();
+        } catch (const std::runtime_error& e) {
+            std::printf("GL backends skipped: %s\n", e.what());
+            skipped.push_back("gl");
+            rectangle.reset();
+        }
+
+        if (rectangle) {
+            auto glBlur = [rectangle, unbounded](const Image& input, float radius, BlurEdgeMode edgeMode,
+                                                 int downscale, BlurOutput& output) {
+                if (edgeMode == BlurEdgeMode::Rectangle) {
+                    GLuint texture = rectangle->uploadBitmapAsTexture(input.pixels.data(), input.width, input.height,
+                                                                      PixelFormat::Rgba8888, input.width * 4);
+                    rectangle->render(texture, input.width, input.height, radius, downscale);
+                    output.width = rectangle->outputWidth();
+                    output.height = rectangle->outputHeight();
+                    output.padding = 0;
+                    output.pixels.resize(static_cast<size_t>(output.width) * output.height * 4);
+                    rectangle->readFBO(output.pixels.data(), output.width, output.height, PixelFormat::Rgba8888,
+                                       output.width * 4);
+                    glDeleteTextures(1, &texture);
+                } else {
+                    GLuint texture = unbounded->uploadBitmapAsTexture(input.pixels.data(), input.width, input.height,
+                                                                      PixelFormat::Rgba8888, input.width * 4);
+                    unbounded->render(texture, input.width, input.height, radius, downscale, output.width, output.height);
+                    output.padding = UnboundedBlurRenderer::calculatePadding(radius);
+                    output.pixels.resize(static_cast<size_t>(output.width) * output.height * 4);
+                    unbounded->readFBO(output.pixels.data(), output.width, output.height, PixelFormat::Rgba8888,
+                                       output.width * 4);
+                    glDeleteTextures(1, &texture);
+                }
+                return true;
+            };
+
+            backends.push_back({"gl", [glBlur](const Image& input, float radius, BlurEdgeMode edgeMode, BlurOutput& output) {
+                return glBlur(input, radius, edgeMode, 1, output);
+            }});
+            backends.push_back({"gl-downscaled", [glBlur](const Image& input, float radius, BlurEdgeMode edgeMode,
+                                                          BlurOutput& output) {
+                int downscale = calculateReadbackDownscale(radius);
+                return downscale > 1 && glBlur(input, radius, edgeMode, downscale, output);
+            }});
+
+            // Final pass into a dma-buf mapped by the CPU instead of read back, where the host's
+            // driver can share buffers with EGL
+            backends.push_back({"gl-shared", [rectangle, &skipped](const Image& input, float radius,
+                                                                   BlurEdgeMode edgeMode, BlurOutput& output) {
+                if (edgeMode != BlurEdgeMode::Rectangle) return false;
+                GLuint texture = rectangle->uploadBitmapAsTexture(input.pixels.data(), input.width, input.height,
+                                                                  PixelFormat::Rgba8888, input.width * 4);
+                std::unique_ptr<SharedImage> image = SharedImage::create(input.width, input.height);
+                if (!image) {
+                    if (std::find(skipped.begin(), skipped.end(), "gl-shared") == skipped.end()) {
+                        std::printf("gl-shared backend skipped: no dma-buf sharing with EGL\n");
+                        skipped.push_back("gl-shared");
+                    }
+                    glDeleteTextures(1, &texture);
+                    return false;
+                }
+
+                rectangle->renderInto(texture, input.width, input.height, radius, 1, image->framebuffer());
+                image->finishRendering();
+                output.width = input.width;
+                output.height = input.height;
+                output.padding = 0;
+                output.pixels.resize(input.pixels.size());
+
+                int stride;
+                const unsigned char* mapped = image->lock(stride);
+                if (mapped) {
+                    size_t rowBytes = static_cast<size_t>(input.width) * 4;
+                    for (int y = 0; y < input.height; ++y) {
+                        std::memcpy(&output.pixels[y * rowBytes], mapped + static_cast<size_t>(y) * stride, rowBytes);
+                    }
+                    image->unlock();
+                }
+                glDeleteTextures(1, &texture);
+                return mapped != nullptr;
+            }});
+
+            auto bandCpu = std::make_shared<CpuBlurRenderer>(threadCount);
+            auto hybrid = std::make_shared<HybridBlurScheduler>(
+                    [rectangle](const unsigned char* pixels, int width, int height, float radius, unsigned char* result) {
+                        GLuint texture = rectangle->uploadBitmapAsTexture(pixels, width, height, PixelFormat::Rgba8888,
+                                                                          width * 4);
+                        rectangle->render(texture, width, height, radius, 1);
+                        rectangle->readFBO(result, width, height, PixelFormat::Rgba8888, width * 4);
+                        glDeleteTextures(1, &texture);
+                    },
+                    [bandCpu](const unsigned char* pixels, int width, int height, float radius, unsigned char* result) {
+                        bandCpu->render(pixels, width, height, radius, result);
+                    });
+            backends.push_back({"hybrid", [hybrid](const Image& input, float radius, BlurEdgeMode edgeMode,
+                                                   BlurOutput& output) {
+                if (edgeMode != BlurEdgeMode::Rectangle) return false;
+                output.width = input.width;
+                output.height = input.height;
+                output.padding = 0;
+                output.pixels.resize(input.pixels.size());
+                hybrid->render(input.pixels.data(), input.width, input.height, radius, output.pixels.data());
+                return true;
+            }});
+        }
+#endif
+
+#if SHADED_HARNESS_VULKAN
+        try {
+            auto vulkan = std::make_shared<VulkanBlurRenderer>();
+            std::printf("Vulkan device: %s\n", vulkan->deviceName());
+            backends.push_back({"vulkan", [vulkan](const Image& input, float radius, BlurEdgeMode edgeMode,
+                                                   BlurOutput& output) {
+                int padding = edgeMode == BlurEdgeMode::Rectangle ? 0 : VulkanBlurRenderer::calculatePadding(radius);
+                output.padding = padding;
+                output.pixels.resize(static_cast<size_t>(input.width + 2 * padding) * (input.height + 2 * padding) * 4);
+                vulkan->render(input.pixels.data(), input.width, input.height, radius, edgeMode, output.pixels.data(),
+                               output.width, output.height);
+                return true;
+            }});
+        } catch (const std::runtime_error& e) {
+            std::printf("Vulkan backend skipped: %s\n", e.what());
+            skipped.push_back("vulkan");
+        }
+#endif
+
+        return backends;
+    }
+
+    const Budget* findBudget(const std::string& mode) {
+        for (const Budget& budget : kBudgets) {
+            if (mode == budget.mode) return &budget;
+        }
+        return nullptr;
+    }
+}
+
+int main() {
+    std::vector<Image> corpus = makeCorpus();
+    std::vector<std::string> skipped;
+    std::vector<Backend> backends = makeBackends(skipped);
+
+    // Keyed by mode, then radius
+    std::map<std::string, std::map<float, ModeResult>> results;
+
+    for (BlurEdgeMode edgeMode : {BlurEdgeMode::Rectangle, BlurEdgeMode::Unbounded}) {
+        const char* edgeName = edgeMode == BlurEdgeMode::Rectangle ? "rectangle" : "unbounded";
+
+        for (float radius : kRadii) {
+            for (const Image& image : corpus) {
+                std::map<int, std::vector<double>> references;
+
+                for (const Backend& backend : backends) {
+                    std::string mode = backend.name + "/" + edgeName;
+                    BlurOutput output;
+
+                    // Once to warm up shaders and buffers, once timed
+                    if (!backend.blur(image, radius, edgeMode, output)) continue;
+                    auto start = std::chrono::steady_clock::now();
+                    backend.blur(image, radius, edgeMode, output);
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+                    ModeResult& result = results[mode][radius];
+                    result.milliseconds += elapsed.count();
+                    result.megapixels += image.width * image.height / 1e6;
+                    int fullWidth = image.width + 2 * output.padding;
+                    int fullHeight = image.height + 2 * output.padding;
+                    auto reference = references.find(output.padding);
+                    if (reference == references.end()) {
+                        reference = references.emplace(output.padding, referenceBlur(
+                                image.pixels.data(), image.width, image.height, radius, edgeMode, output.padding)).first;
+                    }
+
+                    std::vector<double> actual;
+                    if (output.width == fullWidth && output.height == fullHeight) {
+                        actual.assign(output.pixels.begin(), output.pixels.end());
+                    } else {
+                        actual = scaleTo(output, fullWidth, fullHeight);
+                    }
+
+                    double squaredError = 0.0;
+                    double maxError = 0.0;
+                    for (size_t i = 0; i < actual.size(); ++i) {
+                        double error = std::fabs(actual[i] - reference->second[i]);
+                        squaredError += error * error;
+                        maxError = std::max(maxError, error);
+                    }
+                    double meanSquaredError = squaredError / actual.size();
+                    double psnr = meanSquaredError > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : 99.0;
+                    int roundedMaxError = static_cast<int>(std::lround(maxError));
+
+                    result.worstPsnr = std::min(result.worstPsnr, psnr);
+                    result.worstError = std::max(result.worstError, roundedMaxError);
+
+                    const Budget* budget = findBudget(mode);
+                    if (budget && (psnr < budget->minPsnr || roundedMaxError > budget->maxError)) {
+                        std::fprintf(stderr, "FAIL %s radius %.1f %s: PSNR %.1f dB (min %.1f), max error %d (max %d)\n",
+                                     mode.c_str(), radius, image.name, psnr, budget->minPsnr, roundedMaxError,
+                                     budget->maxError);
+                        ++failures;
+                    }
+                }
+            }
+        }
+    }
+
+    std::printf("%-24s %7s %10s %10s %10s\n", "mode", "radius", "PSNR dB", "max error", "ms/MP");
+    for (const auto& mode : results) {
+        for (const auto& entry : mode.second) {
+            const ModeResult& result = entry.second;
+            double millisecondsPerMegapixel = result.milliseconds / result.megapixels;
+            std::printf("%-24s %7.1f %10.1f %10d %10.2f\n", mode.first.c_str(), entry.first,
+                        result.worstPsnr, result.worstError, millisecondsPerMegapixel);
+        }
+    }
+
+    // Reported as skipped rather than passed, so a host without GL doesn't look like a pass of
+    // every backend
+    if (failures == 0 && !skipped.empty()) {
+        std::string names;
+        for (const std::string& name : skipped) names += (names.empty() ? "" : ", ") + name;
+        std::printf("blur_accuracy_test skipped %s\n", names.c_str());
+        return kSkipped;
+    }
+    return finishTest("blur_accuracy_test");
+}
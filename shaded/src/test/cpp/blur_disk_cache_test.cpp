@@ -0,0 +1,228 @@
+#include "blur_disk_cache.h"
+#include "test_support.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fcntl.h>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Stores and looks up entries of BlurDiskCache in a temporary directory: round trips, keys that
+// don't match, least recently used eviction, overwrites, and readers racing a writer.
+
+namespace {
+    const int kWidth = 8;
+    const int kHeight = 8;
+    // Header and pixels of a kWidth x kHeight entry
+    const size_t kEntryBytes = 64 + kWidth * kHeight * 4;
+
+    // Every byte derives from value, so entries can be told apart and torn ones stand out
+    std::vector<unsigned char> filledPixels(unsigned char value, int stride = kWidth * 4) {
+        std::vector<unsigned char> pixels(static_cast<size_t>(stride) * kHeight, 0xee);
+        for (int y = 0; y < kHeight; ++y) {
+            for (int x = 0; x < kWidth * 4; ++x) pixels[y * stride + x] = static_cast<unsigned char>(value + y);
+        }
+        return pixels;
+    }
+
+    bool holds(const BlurDiskCache::Entry& entry, unsigned char value) {
+        if (entry.width() != kWidth || entry.height() != kHeight) return false;
+        std::vector<unsigned char> expected = filledPixels(value);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            if (entry.pixels()[i] != expected[i]) return false;
+        }
+        return true;
+    }
+
+    std::string makeDirectory() {
+        char path[] = "/tmp/blur_disk_cache_testXXXXXX";
+        return mkdtemp(path) ? path : "";
+    }
+
+    void removeDirectory(const std::string& path) {
+        if (DIR* directory = opendir(path.c_str())) {
+            while (dirent* entry = readdir(directory)) {
+                std::string name = entry->d_name;
+                if (name != "." && name != "..") unlink((path + "/" + name).c_str());
+            }
+            closedir(directory);
+        }
+        rmdir(path.c_str());
+    }
+
+    // Sets the modification time eviction goes by, seconds apart so file system timestamp
+    // granularity doesn't matter
+    void setModified(const std::string& directory, uint64_t key, time_t seconds) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.blur", static_cast<unsigned long long>(key));
+        timespec times[2] = {{seconds, 0}, {seconds, 0}};
+        utimensat(AT_FDCWD, (directory + name).c_str(), times, 0);
+    }
+
+    void checkRoundTrip() {
+        std::string directory = makeDirectory();
+        BlurDiskCache cache(directory, 1 << 20);
+        uint64_t key = BlurDiskCache::makeKey(1234, kWidth, kHeight, 10.0f, BlurEdgeMode::Rectangle);
+
+        expect(cache.lookup(key) == nullptr, "an empty cache misses");
+        std::vector<unsigned char> pixels = filledPixels(10);
+        cache.store(key, kWidth, kHeight, pixels.data(), kWidth * 4);
+
+        std::unique_ptr<BlurDiskCache::Entry> entry = cache.lookup(key);
+        expect(entry && holds(*entry, 10), "a stored entry comes back as stored");
+        expect(cache.totalBytes() == kEntryBytes, "a stored entry is counted");
+
+        // Rows with padding behind them are stored packed and copied back out with padding
+        int stride = kWidth * 4 + 12;
+        uint64_t paddedKey = BlurDiskCache::makeKey(5678, kWidth, kHeight, 10.0f, BlurEdgeMode::Rectangle);
+        std::vector<unsigned char> padded = filledPixels(20, stride);
+        cache.store(paddedKey, kWidth, kHeight, padded.data(), stride);
+        entry = cache.lookup(paddedKey);
+        expect(entry && holds(*entry, 20), "padded rows are stored packed");
+        if (entry) {
+            std::vector<unsigned char> copy(padded.size(), 0xee);
+            entry->copyPixels(copy.data(), stride);
+            expect(copy == padded, "entries are copied into padded rows");
+        }
+
+        removeDirectory(directory);
+    }
+
+    void checkKeyMismatch() {
+        std::string directory = makeDirectory();
+        BlurDiskCache cache(directory, 1 << 20);
+        uint64_t key = BlurDiskCache::makeKey(1234, kWidth, kHeight, 10.0f, BlurEdgeMode::Rectangle);
+        std::vector<unsigned char> pixels = filledPixels(10);
+        cache.store(key, kWidth, kHeight, pixels.data(), kWidth * 4);
+
+        expect(BlurDiskCache::makeKey(1234, kWidth, kHeight, 10.5f, BlurEdgeMode::Rectangle) != key &&
+               BlurDiskCache::makeKey(1234, kWidth, kHeight, 10.0f, BlurEdgeMode::Unbounded) != key &&
+               BlurDiskCache::makeKey(1235, kWidth, kHeight, 10.0f, BlurEdgeMode::Rectangle) != key &&
+               BlurDiskCache::makeKey(1234, kHeight + 1, kWidth, 10.0f, BlurEdgeMode::Rectangle) != key,
+               "every parameter goes into the key");
+        expect(cache.lookup(key + 1) == nullptr, "other keys miss");
+
+        // A file under the wrong name, like one copied over by hand, is rejected by its header
+        char from[32], to[32];
+        std::snprintf(from, sizeof(from), "/%016llx.blur", static_cast<unsigned long long>(key));
+        std::snprintf(to, sizeof(to), "/%016llx.blur", static_cast<unsigned long long>(key + 1));
+        std::rename((directory + from).c_str(), (directory + to).c_str());
+        expect(cache.lookup(key + 1) == nullptr, "entries whose header holds another key miss");
+
+        removeDirectory(directory);
+    }
+
+    void checkHashIgnoresPadding() {
+        int paddedStride = kWidth * 4 + 12;
+        std::vector<unsigned char> packed = filledPixels(30);
+        std::vector<unsigned char> padded = filledPixels(30, paddedStride);
+        std::vector<unsigned char> otherPadding = padded;
+        for (int y = 0; y < kHeight; ++y) otherPadding[y * paddedStride + kWidth * 4] = 0x11;
+
+        uint64_t hash = BlurDiskCache::hashPixels(packed.data(), kWidth, kHeight, kWidth * 4);
+        expect(BlurDiskCache::hashPixels(padded.data(), kWidth, kHeight, paddedStride) == hash &&
+               BlurDiskCache::hashPixels(otherPadding.data(), kWidth, kHeight, paddedStride) == hash,
+               "row padding doesn't change the hash");
+        expect(BlurDiskCache::hashPixels(filledPixels(31).data(), kWidth, kHeight, kWidth * 4) != hash,
+               "other pixels hash differently");
+    }
+
+    void checkLeastRecentlyUsedEviction() {
+        std::string directory = makeDirectory();
+        // Room for three entries, eviction goes down to 3/4 of that
+        BlurDiskCache cache(directory, 3 * kEntryBytes + 10);
+        std::vector<unsigned char> pixels = filledPixels(10);
+
+        for (uint64_t key = 1; key <= 3; ++key) {
+            cache.store(key, kWidth, kHeight, pixels.data(), kWidth * 4);
+            setModified(directory, key, 1000 * static_cast<time_t>(key));
+        }
+        // Using the oldest entry makes the second one the least recently used
+        expect(cache.lookup(1) != nullptr, "entries within budget stay");
+
+        cache.store(4, kWidth, kHeight, pixels.data(), kWidth * 4);
+        expect(cache.lookup(2) == nullptr, "the least recently used entry is evicted first");
+        expect(cache.lookup(3) == nullptr, "entries are evicted down to 3/4 of the budget");
+        expect(cache.lookup(1) != nullptr, "a recently used entry survives eviction");
+        expect(cache.lookup(4) != nullptr, "the new entry survives eviction");
+        expect(cache.totalBytes() == 2 * kEntryBytes, "evicted entries are no longer counted");
+
+        // Entries larger than the whole budget aren't stored at all
+        BlurDiskCache tiny(directory, kEntryBytes - 1);
+        tiny.store(5, kWidth, kHeight, pixels.data(), kWidth * 4);
+        expect(tiny.lookup(5) == nullptr, "entries over the budget aren't stored");
+
+        removeDirectory(directory);
+    }
+
+    void checkOverwrite() {
+        std::string directory = makeDirectory();
+        BlurDiskCache cache(directory, 1 << 20);
+        std::vector<unsigned char> first = filledPixels(10);
+        std::vector<unsigned char> second = filledPixels(90);
+
+        cache.store(7, kWidth, kHeight, first.data(), kWidth * 4);
+        std::unique_ptr<BlurDiskCache::Entry> old = cache.lookup(7);
+        for (int i = 0; i < 5; ++i) cache.store(7, kWidth, kHeight, second.data(), kWidth * 4);
+
+        std::unique_ptr<BlurDiskCache::Entry> entry = cache.lookup(7);
+        expect(entry && holds(*entry, 90), "an overwritten key returns the newest entry");
+        expect(old && holds(*old, 10), "mappings of the replaced entry stay valid");
+        expect(cache.totalBytes() == kEntryBytes, "an overwritten key is counted once");
+
+        // A new cache over the same directory counts what is on disk, the same total
+        BlurDiskCache reopened(directory, 1 << 20);
+        expect(reopened.totalBytes() == kEntryBytes, "the directory holds a single entry");
+
+        removeDirectory(directory);
+    }
+
+    void checkReaderDuringRename() {
+        std::string directory = makeDirectory();
+        BlurDiskCache cache(directory, 1 << 20);
+        std::vector<unsigned char> first = filledPixels(10);
+        std::vector<unsigned char> second = filledPixels(90);
+        cache.store(7, kWidth, kHeight, first.data(), kWidth * 4);
+
+        std::atomic<bool> done(false);
+        std::atomic<int> lookups(0);
+        std::atomic<int> torn(0);
+        std::thread reader([&] {
+            while (!done) {
+                std::unique_ptr<BlurDiskCache::Entry> entry = cache.lookup(7);
+                ++lookups;
+                if (!entry || !(holds(*entry, 10) || holds(*entry, 90))) ++torn;
+            }
+        });
+
+        for (int i = 0; i < 500; ++i) {
+            const std::vector<unsigned char>& pixels = i % 2 == 0 ? second : first;
+            cache.store(7, kWidth, kHeight, pixels.data(), kWidth * 4);
+        }
+        // Let the reader get some lookups in even when it only got scheduled now
+        while (lookups < 100) std::this_thread::yield();
+        done = true;
+        reader.join();
+
+        expect(torn == 0, "readers only ever see one complete entry or the other");
+        expect(cache.totalBytes() == kEntryBytes, "racing overwrites are counted once");
+
+        removeDirectory(directory);
+    }
+}
+
+int main() {
+    checkRoundTrip();
+    checkKeyMismatch();
+    checkHashIgnoresPadding();
+    checkLeastRecentlyUsedEviction();
+    checkOverwrite();
+    checkReaderDuringRename();
+
+    return finishTest("blur_disk_cache_test");
+}
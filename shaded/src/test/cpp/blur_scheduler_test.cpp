@@ -0,0 +1,180 @@
+#include "blur_scheduler.h"
+#include "render_thread.h"
+#include "test_support.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Drives BlurJobScheduler with a hand-cranked executor to check coalescing, deadlines and
+// priorities step by step, then on a real RenderThread kept busy by a slow job.
+
+namespace {
+    const int64_t kSecond = 1000000000LL;
+
+    // Executor that only runs tasks when asked to
+    struct ManualExecutor {
+        std::deque<std::function<void()>> tasks;
+
+        BlurJobScheduler::Executor executor() {
+            return [this](std::function<void()> task) { tasks.push_back(std::move(task)); };
+        }
+
+        void runOne() {
+            std::function<void()> task = std::move(tasks.front());
+            tasks.pop_front();
+            task();
+        }
+
+        void runAll() {
+            while (!tasks.empty()) runOne();
+        }
+    };
+
+    // What happened to each job, by the tag it was submitted with
+    struct Log {
+        std::vector<int> ran;
+        std::vector<std::pair<int, BlurJobOutcome>> discarded;
+    };
+
+    BlurJob makeJob(Log& log, int64_t surfaceId, int64_t deadlineNanos, int tag) {
+        BlurJob job;
+        job.surfaceId = surfaceId;
+        job.deadlineNanos = deadlineNanos;
+        job.run = [&log, tag] { log.ran.push_back(tag); };
+        job.discard = [&log, tag](BlurJobOutcome outcome) { log.discarded.emplace_back(tag, outcome); };
+        return job;
+    }
+
+    void checkNewestJobOfSurfaceRuns() {
+        ManualExecutor executor;
+        BlurJobScheduler scheduler(executor.executor());
+        Log log;
+        int64_t deadline = BlurJobScheduler::now() + 10 * kSecond;
+
+        scheduler.submit(makeJob(log, 1, deadline, 1));
+        scheduler.submit(makeJob(log, 1, deadline, 2));
+        scheduler.submit(makeJob(log, 1, deadline, 3));
+        scheduler.submit(makeJob(log, 2, deadline, 4));
+        expect(log.discarded.empty(), "coalesced jobs are only discarded on the executor thread");
+
+        executor.runAll();
+        expect(log.ran == std::vector<int>({3, 4}) || log.ran == std::vector<int>({4, 3}),
+               "only the newest job of each surface runs");
+        expect(log.discarded.size() == 2, "replaced jobs are discarded");
+        for (const auto& entry : log.discarded) {
+            expect(entry.first == 1 || entry.first == 2, "discarded jobs are the replaced ones");
+            expect(entry.second == BlurJobOutcome::Coalesced, "replaced jobs end as coalesced");
+        }
+
+        BlurJobStats stats = scheduler.stats();
+        expect(stats.submitted == 4, "submitted jobs are counted");
+        expect(stats.started == 2, "started jobs are counted");
+        expect(stats.coalesced == 2, "coalesced jobs are counted");
+        expect(stats.expired == 0, "no job expired");
+    }
+
+    void checkStartedJobIsNotReplaced() {
+        ManualExecutor executor;
+        BlurJobScheduler scheduler(executor.executor());
+        Log log;
+        int64_t deadline = BlurJobScheduler::now() + 10 * kSecond;
+
+        scheduler.submit(makeJob(log, 1, deadline, 1));
+        executor.runOne();
+        scheduler.submit(makeJob(log, 1, deadline, 2));
+        executor.runAll();
+        expect(log.ran == std::vector<int>({1, 2}), "a job submitted after the previous one started runs too");
+        expect(scheduler.stats().coalesced == 0, "nothing was coalesced");
+    }
+
+    void checkExpiredJobsAreDropped() {
+        ManualExecutor executor;
+        BlurJobScheduler scheduler(executor.executor());
+        Log log;
+        int64_t now = BlurJobScheduler::now();
+
+        scheduler.submit(makeJob(log, 1, now - 1, 1));
+        scheduler.submit(makeJob(log, 2, now + 10 * kSecond, 2));
+        executor.runAll();
+        expect(log.ran == std::vector<int>({2}), "jobs past their deadline don't run");
+        expect(log.discarded.size() == 1 && log.discarded[0].first == 1 &&
+               log.discarded[0].second == BlurJobOutcome::Expired, "jobs past their deadline end as expired");
+        expect(scheduler.stats().expired == 1, "expired jobs are counted");
+    }
+
+    void checkEarliestDeadlineStartsFirst() {
+        ManualExecutor executor;
+        BlurJobScheduler scheduler(executor.executor());
+        Log log;
+        int64_t now = BlurJobScheduler::now();
+
+        scheduler.submit(makeJob(log, 1, now + 30 * kSecond, 1));
+        scheduler.submit(makeJob(log, 2, now + 10 * kSecond, 2));
+        scheduler.submit(makeJob(log, 3, now + 20 * kSecond, 3));
+        executor.runAll();
+        expect(log.ran == std::vector<int>({2, 3, 1}), "jobs start in deadline order");
+    }
+
+    // Many surfaces submitting every "frame" while the render thread is stuck on a slow job:
+    // every job either runs or is reported, and each surface ends with its newest job run.
+    void checkOnRenderThreadUnderLoad() {
+        RenderThread thread;
+        BlurJobScheduler scheduler([&thread](std::function<void()> task) { thread.post(std::move(task)); });
+
+        const int surfaces = 4;
+        const int frames = 50;
+        std::mutex mutex;
+        std::vector<int> lastRun(surfaces, -1);
+        std::atomic<int> finished(0);
+        std::atomic<bool> release(false);
+
+        BlurJob slow;
+        slow.surfaceId = surfaces;
+        slow.deadlineNanos = BlurJobScheduler::now() + 10 * kSecond;
+        slow.run = [&] {
+            while (!release) std::this_thread::yield();
+        };
+        slow.discard = [](BlurJobOutcome) {};
+        scheduler.submit(std::move(slow));
+
+        for (int frame = 0; frame < frames; ++frame) {
+            for (int surface = 0; surface < surfaces; ++surface) {
+                BlurJob job;
+                job.surfaceId = surface;
+                job.deadlineNanos = BlurJobScheduler::now() + 10 * kSecond;
+                job.run = [&, surface, frame] {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    lastRun[surface] = frame;
+                    ++finished;
+                };
+                job.discard = [&](BlurJobOutcome) { ++finished; };
+                scheduler.submit(std::move(job));
+            }
+        }
+        release = true;
+
+        thread.runSync([] {});
+        expect(finished == surfaces * frames, "every job ran or was discarded");
+        for (int surface = 0; surface < surfaces; ++surface) {
+            expect(lastRun[surface] == frames - 1, "each surface ends with its newest job");
+        }
+        BlurJobStats stats = scheduler.stats();
+        expect(stats.started == static_cast<uint64_t>(surfaces) + 1, "jobs queued behind a busy thread are coalesced");
+        expect(stats.started + stats.coalesced + stats.expired == stats.submitted, "counters add up");
+    }
+}
+
+int main() {
+    checkNewestJobOfSurfaceRuns();
+    checkStartedJobIsNotReplaced();
+    checkExpiredJobsAreDropped();
+    checkEarliestDeadlineStartsFirst();
+    checkOnRenderThreadUnderLoad();
+
+    return finishTest("blur_scheduler_test");
+}
@@ -0,0 +1,206 @@
+#include "gl_call_recorder.h"
+#include <EGL/egl.h>
+#include <GLES2/gl2.h>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+
+GLCallRecorder& GLCallRecorder::instance() {
+    static GLCallRecorder recorder;
+    return recorder;
+}
+
+void GLCallRecorder::record(const char* function) {
+    ++counts_[function];
+}
+
+void GLCallRecorder::reset() {
+    counts_.clear();
+    textureAllocations_ = 0;
+    nonFiniteUniforms_ = 0;
+}
+
+void GLCallRecorder::recordUniformValue(float value) {
+    if (!std::isfinite(value)) ++nonFiniteUniforms_;
+}
+
+int GLCallRecorder::count(const std::string& function) const {
+    auto it = counts_.find(function);
+    return it == counts_.end() ? 0 : it->second;
+}
+
+int GLCallRecorder::total() const {
+    int sum = 0;
+    for (const auto& entry : counts_) sum += entry.second;
+    return sum;
+}
+
+int GLCallRecorder::stateChanges() const {
+    static const char* const kStateFunctions[] = {
+            "glActiveTexture", "glBindBuffer", "glBindFramebuffer", "glBindTexture", "glClearColor",
+            "glDisable", "glDisableVertexAttribArray", "glEnable", "glEnableVertexAttribArray",
+            "glPixelStorei", "glScissor", "glUseProgram", "glVertexAttribPointer", "glViewport",
+            "eglMakeCurrent",
+    };
+
+    int sum = 0;
+    for (const char* function : kStateFunctions) sum += count(function);
+    return sum;
+}
+
+namespace {
+    GLuint nextName = 1;
+
+    void record(const char* function) {
+        GLCallRecorder::instance().record(function);
+    }
+
+    void recordUniformValues(std::initializer_list<GLfloat> values) {
+        for (GLfloat value : values) GLCallRecorder::instance().recordUniformValue(value);
+    }
+
+    void generate(GLsizei n, GLuint* names) {
+        for (GLsizei i = 0; i < n; ++i) names[i] = nextName++;
+    }
+
+    // Any distinct non-null handles will do, nothing ever dereferences them
+    int displayHandle, configHandle;
+    int contextHandles[64], surfaceHandles[64];
+    int nextContext = 0, nextSurface = 0;
+}
+
+// EGL
+
+EGLDisplay eglGetDisplay(EGLNativeDisplayType) { record("eglGetDisplay"); return &displayHandle; }
+
+EGLBoolean eglInitialize(EGLDisplay, EGLint* major, EGLint* minor) {
+    record("eglInitialize");
+    if (major) *major = 1;
+    if (minor) *minor = 4;
+    return EGL_TRUE;
+}
+
+EGLBoolean eglChooseConfig(EGLDisplay, const EGLint*, EGLConfig* configs, EGLint configSize, EGLint* numConfig) {
+    record("eglChooseConfig");
+    if (configs && configSize > 0) configs[0] = &configHandle;
+    *numConfig = 1;
+    return EGL_TRUE;
+}
+
+EGLContext eglCreateContext(EGLDisplay, EGLConfig, EGLContext, const EGLint*) {
+    record("eglCreateContext");
+    return &contextHandles[nextContext++ % 64];
+}
+
+EGLSurface eglCreatePbufferSurface(EGLDisplay, EGLConfig, const EGLint*) {
+    record("eglCreatePbufferSurface");
+    return &surfaceHandles[nextSurface++ % 64];
+}
+
+EGLBoolean eglMakeCurrent(EGLDisplay, EGLSurface, EGLSurface, EGLContext) { record("eglMakeCurrent"); return EGL_TRUE; }
+EGLBoolean eglDestroyContext(EGLDisplay, EGLContext) { record("eglDestroyContext"); return EGL_TRUE; }
+EGLBoolean eglDestroySurface(EGLDisplay, EGLSurface) { record("eglDestroySurface"); return EGL_TRUE; }
+EGLBoolean eglTerminate(EGLDisplay) { record("eglTerminate"); return EGL_TRUE; }
+
+// Object creation
+
+GLuint glCreateShader(GLenum) { record("glCreateShader"); return nextName++; }
+GLuint glCreateProgram() { record("glCreateProgram"); return nextName++; }
+void glGenBuffers(GLsizei n, GLuint* buffers) { record("glGenBuffers"); generate(n, buffers); }
+void glGenFramebuffers(GLsizei n, GLuint* framebuffers) { record("glGenFramebuffers"); generate(n, framebuffers); }
+void glGenTextures(GLsizei n, GLuint* textures) { record("glGenTextures"); generate(n, textures); }
+void glDeleteShader(GLuint) { record("glDeleteShader"); }
+void glDeleteTextures(GLsizei, const GLuint*) { record("glDeleteTextures"); }
+
+// Shaders and programs
+
+void glShaderSource(GLuint, GLsizei, const GLchar* const*, const GLint*) { record("glShaderSource"); }
+void glCompileShader(GLuint) { record("glCompileShader"); }
+
+void glGetShaderiv(GLuint, GLenum pname, GLint* params) {
+    record("glGetShaderiv");
+    *params = pname == GL_COMPILE_STATUS ? GL_TRUE : 0;
+}
+
+void glGetShaderInfoLog(GLuint, GLsizei bufSize, GLsizei* length, GLchar* infoLog) {
+    record("glGetShaderInfoLog");
+    if (length) *length = 0;
+    if (bufSize > 0) infoLog[0] = '\0';
+}
+
+void glAttachShader(GLuint, GLuint) { record("glAttachShader"); }
+void glBindAttribLocation(GLuint, GLuint, const GLchar*) { record("glBindAttribLocation"); }
+void glLinkProgram(GLuint) { record("glLinkProgram"); }
+void glUseProgram(GLuint) { record("glUseProgram"); }
+
+GLint glGetAttribLocation(GLuint, const GLchar*) { record("glGetAttribLocation"); return 0; }
+
+GLint glGetUniformLocation(GLuint, const GLchar* name) {
+    record("glGetUniformLocation");
+    return static_cast<GLint>(std::strlen(name));
+}
+
+void glUniform1f(GLint, GLfloat x) { record("glUniform1f"); recordUniformValues({x}); }
+void glUniform1i(GLint, GLint) { record("glUniform1i"); }
+void glUniform2f(GLint, GLfloat x, GLfloat y) { record("glUniform2f"); recordUniformValues({x, y}); }
+void glUniform3f(GLint, GLfloat x, GLfloat y, GLfloat z) { record("glUniform3f"); recordUniformValues({x, y, z}); }
+void glUniform4f(GLint, GLfloat x, GLfloat y, GLfloat z, GLfloat w) {
+    record("glUniform4f");
+    recordUniformValues({x, y, z, w});
+}
+
+// State
+
+void glActiveTexture(GLenum) { record("glActiveTexture"); }
+void glBindBuffer(GLenum, GLuint) { record("glBindBuffer"); }
+void glBindFramebuffer(GLenum, GLuint) { record("glBindFramebuffer"); }
+void glBindTexture(GLenum, GLuint) { record("glBindTexture"); }
+void glClearColor(GLfloat, GLfloat, GLfloat, GLfloat) { record("glClearColor"); }
+void glDisable(GLenum) { record("glDisable"); }
+void glEnable(GLenum) { record("glEnable"); }
+void glEnableVertexAttribArray(GLuint) { record("glEnableVertexAttribArray"); }
+void glDisableVertexAttribArray(GLuint) { record("glDisableVertexAttribArray"); }
+void glPixelStorei(GLenum, GLint) { record("glPixelStorei"); }
+void glScissor(GLint, GLint, GLsizei, GLsizei) { record("glScissor"); }
+void glTexParameteri(GLenum, GLenum, GLint) { record("glTexParameteri"); }
+void glVertexAttribPointer(GLuint, GLint, GLenum, GLboolean, GLsizei, const void*) { record("glVertexAttribPointer"); }
+void glViewport(GLint, GLint, GLsizei, GLsizei) { record("glViewport"); }
+
+// Data
+
+void glBufferData(GLenum, GLsizeiptr, const void*, GLenum) { record("glBufferData"); }
+
+void glTexImage2D(GLenum, GLint, GLint, GLsizei, GLsizei, GLint, GLenum, GLenum, const void* pixels) {
+    record("glTexImage2D");
+    if (!pixels) GLCallRecorder::instance().recordTextureAllocation();
+}
+
+void glFramebufferTexture2D(GLenum, GLenum, GLenum, GLuint, GLint) { record("glFramebufferTexture2D"); }
+
+void glReadPixels(GLint, GLint, GLsizei width, GLsizei height, GLenum, GLenum, void* pixels) {
+    record("glReadPixels");
+    std::memset(pixels, 0, static_cast<size_t>(width) * height * 4);
+}
+
+// Drawing
+
+void glClear(GLbitfield) { record("glClear"); }
+void glDrawArrays(GLenum, GLint, GLsizei) { record("glDrawArrays"); }
+
+// Queries
+
+GLenum glGetError() { record("glGetError"); return GL_NO_ERROR; }
+
+// Reads back RGBA8888 only, the one readback GLES2 guarantees
+void glGetIntegerv(GLenum name, GLint* value) {
+    record("glGetIntegerv");
+    if (name == GL_IMPLEMENTATION_COLOR_READ_FORMAT) *value = GL_RGBA;
+    else if (name == GL_IMPLEMENTATION_COLOR_READ_TYPE) *value = GL_UNSIGNED_BYTE;
+    else *value = 0;
+}
+
+const GLubyte* glGetString(GLenum) {
+    record("glGetString");
+    return reinterpret_cast<const GLubyte*>("");
+}
@@ -0,0 +1,39 @@
+#ifndef GL_CALL_RECORDER_H
+#define GL_CALL_RECORDER_H
+
+#include <map>
+#include <string>
+
+// Counts every GLES2 / EGL call made against the fake library in fake_gles.cpp.
+// There is no GPU behind it: objects get increasing names, shaders always compile and
+// glReadPixels returns zeros, which is enough to drive the renderers' control flow.
+class GLCallRecorder {
+public:
+    static GLCallRecorder& instance();
+
+    void record(const char* function);
+    void reset();
+
+    int count(const std::string& function) const;
+    int total() const;
+
+    // glTexImage2D calls that allocate storage without uploading pixels
+    int textureAllocations() const { return textureAllocations_; }
+    void recordTextureAllocation() { ++textureAllocations_; }
+
+    // Float uniforms set to NaN or infinity
+    int nonFiniteUniforms() const { return nonFiniteUniforms_; }
+    void recordUniformValue(float value);
+
+    // Calls that only change context state: binds, program, viewport, capabilities, ...
+    int stateChanges() const;
+
+    const std::map<std::string, int>& counts() const { return counts_; }
+
+private:
+    std::map<std::string, int> counts_;
+    int textureAllocations_ = 0;
+    int nonFiniteUniforms_ = 0;
+};
+
+#endif // GL_CALL_RECORDER_H
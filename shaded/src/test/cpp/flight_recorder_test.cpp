@@ -0,0 +1,126 @@
+#include "flight_recorder.h"
+#include "test_support.h"
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Records blur calls into the process wide flight recorder and reads them back, including
+// while other threads keep writing, to check that readers never see half written events.
+
+namespace {
+    // Every field derives from value, so a torn copy shows up as a mismatch
+    BlurTraceEvent markedEvent(int value) {
+        BlurTraceEvent event = {};
+        event.startNanos = value;
+        event.endNanos = value * 2LL;
+        for (int stage = 0; stage < kBlurStageCount; ++stage) {
+            event.stageStartNanos[stage] = value + stage;
+            event.stageEndNanos[stage] = value + stage + 1;
+            event.stageThread[stage] = static_cast<uint32_t>(value);
+        }
+        event.thread = static_cast<uint32_t>(value);
+        event.width = value;
+        event.height = value * 3;
+        event.radius = static_cast<float>(value % 1000);
+        return event;
+    }
+
+    bool isConsistent(const BlurTraceEvent& event) {
+        return event.startNanos == event.width && event.endNanos == event.width * 2LL &&
+               event.height == event.width * 3 && event.thread == static_cast<uint32_t>(event.width) &&
+               event.stageEndNanos[kBlurStageCount - 1] == event.width + kBlurStageCount &&
+               event.radius == static_cast<float>(event.width % 1000);
+    }
+
+    size_t count(const std::string& text, const std::string& pattern) {
+        size_t found = 0;
+        for (size_t at = text.find(pattern); at != std::string::npos; at = text.find(pattern, at + 1)) ++found;
+        return found;
+    }
+
+    void checkTraceRecordsStages() {
+        {
+            BlurTrace trace(321, 123, 7.5f, BlurEdgeMode::Unbounded);
+            trace.setBackend(BlurBackend::Cpu);
+            trace.setCacheOutcome(CacheOutcome::Miss);
+            std::thread worker([&] { BlurTrace::Stage stage(trace, BlurStage::Render); });
+            worker.join();
+        }
+
+        std::vector<BlurTraceEvent> events = FlightRecorder::instance().snapshot();
+        expect(!events.empty(), "a finished blur trace is recorded");
+        if (events.empty()) return;
+
+        const BlurTraceEvent& event = events.back();
+        int render = static_cast<int>(BlurStage::Render);
+        expect(event.width == 321 && event.height == 123 && event.radius == 7.5f, "size and radius are kept");
+        expect(event.backend == BlurBackend::Cpu && event.cacheOutcome == CacheOutcome::Miss,
+               "backend and cache outcome are kept");
+        expect(event.stageStartNanos[render] >= event.startNanos &&
+               event.stageEndNanos[render] >= event.stageStartNanos[render] &&
+               event.endNanos >= event.stageEndNanos[render], "the stage lies within the blur");
+        expect(event.stageThread[render] != event.thread, "the stage is attributed to the thread that ran it");
+        expect(event.stageStartNanos[static_cast<int>(BlurStage::Upload)] == 0, "stages that didn't run stay empty");
+
+        std::string json = FlightRecorder::instance().toChromeTraceJson();
+        expect(json.find("\"traceEvents\":[") != std::string::npos, "the dump is in trace event format");
+        expect(json.find("\"name\":\"blur unbounded 321x123\"") != std::string::npos, "the blur is named by size");
+        expect(json.find("\"name\":\"render\"") != std::string::npos, "the stage is dumped");
+        expect(count(json, "{") == count(json, "}") && count(json, "[") == count(json, "]"),
+               "the dump is balanced");
+    }
+
+    void checkWrapAroundKeepsLatest() {
+        FlightRecorder& recorder = FlightRecorder::instance();
+        const int total = static_cast<int>(FlightRecorder::kCapacity) * 3 + 17;
+        for (int i = 1; i <= total; ++i) recorder.record(markedEvent(i));
+
+        std::vector<BlurTraceEvent> events = recorder.snapshot();
+        expect(events.size() == FlightRecorder::kCapacity, "a full ring holds kCapacity events");
+        bool ordered = true;
+        for (size_t i = 0; i < events.size(); ++i) {
+            ordered &= events[i].width == total - static_cast<int>(events.size()) + 1 + static_cast<int>(i);
+        }
+        expect(ordered, "the latest events are kept, oldest first");
+    }
+
+    void checkConcurrentWritersAreNeverTorn() {
+        FlightRecorder& recorder = FlightRecorder::instance();
+        const int writers = 4, perWriter = 50000;
+        std::atomic<bool> writing(true);
+        std::atomic<int> finished(0);
+
+        std::vector<std::thread> threads;
+        for (int writer = 0; writer < writers; ++writer) {
+            threads.emplace_back([&, writer] {
+                for (int i = 1; i <= perWriter; ++i) recorder.record(markedEvent(writer * perWriter + i));
+                if (++finished == writers) writing = false;
+            });
+        }
+
+        int snapshots = 0;
+        bool consistent = true, bounded = true;
+        while (writing) {
+            std::vector<BlurTraceEvent> events = recorder.snapshot();
+            bounded &= events.size() <= FlightRecorder::kCapacity;
+            for (const BlurTraceEvent& event : events) consistent &= isConsistent(event);
+            ++snapshots;
+        }
+        for (std::thread& thread : threads) thread.join();
+
+        std::printf("%d snapshots taken while %d threads recorded %d events each\n", snapshots, writers, perWriter);
+        expect(consistent, "snapshots taken during writes hold no torn events");
+        expect(bounded, "snapshots never exceed the capacity");
+        expect(recorder.snapshot().size() == FlightRecorder::kCapacity, "the ring is full after the writers finish");
+    }
+}
+
+int main() {
+    checkTraceRecordsStages();
+    checkWrapAroundKeepsLatest();
+    checkConcurrentWritersAreNeverTorn();
+
+    return finishTest("flight_recorder_test");
+}
@@ -0,0 +1,159 @@
+#include "cpu_blur.h"
+#include "hybrid_blur.h"
+#include "test_support.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+// Drives HybridBlurScheduler with two CPU renderers standing in for the GPU and CPU sides.
+// The stand-ins can be slowed down per pixel or made to fail, to check that the split follows
+// measured throughput and that split results match a blur of the whole image. Bands are timed
+// on a virtual clock only the stand-ins advance, so how fast this build and machine actually
+// blur doesn't change the measured speeds.
+
+namespace {
+    // Seconds of virtual time per thread, each side's band is timed on the thread that runs it
+    thread_local double virtualSeconds = 0.0;
+
+    double virtualClock() {
+        return virtualSeconds;
+    }
+
+    // Blurs on its own CPU renderer, then takes nanosecondsPerPixel of virtual time for every
+    // pixel it blurred
+    struct FakeSide {
+        CpuBlurRenderer renderer{2};
+        double nanosecondsPerPixel = 0.0;
+        bool failing = false;
+        int calls = 0;
+        std::vector<int> heights;
+
+        HybridBlurScheduler::BandRenderer bandRenderer() {
+            return [this](const unsigned char* input, int width, int height, float radius, unsigned char* output) {
+                ++calls;
+                heights.push_back(height);
+                if (failing) throw std::runtime_error("context lost");
+                renderer.render(input, width, height, radius, output);
+                virtualSeconds += nanosecondsPerPixel * width * height * 1e-9;
+            };
+        }
+    };
+
+    void checkSplitMatchesWholeImage() {
+        FakeSide gpu, cpu;
+        HybridBlurScheduler scheduler(gpu.bandRenderer(), cpu.bandRenderer(), virtualClock);
+        CpuBlurRenderer reference(2);
+
+        for (float radius : {0.3f, 1.0f, 3.5f, 12.0f, 40.0f}) {
+            const int width = 131, height = 203;
+            std::vector<unsigned char> input = randomImage(width, height, static_cast<unsigned>(radius * 10));
+            std::vector<unsigned char> expected(input.size());
+            reference.render(input.data(), width, height, radius, expected.data());
+
+            // In place, like blurRectangle does with the bitmap
+            std::vector<unsigned char> pixels = input;
+            scheduler.render(pixels.data(), width, height, radius, pixels.data());
+
+            char what[64];
+            std::snprintf(what, sizeof(what), "split blur radius %.1f matches whole image", radius);
+            expect(pixels == expected, what);
+        }
+        expect(gpu.calls > 0 && cpu.calls > 0, "both sides take part while their speeds are equal");
+    }
+
+    void checkShareFollowsThroughput() {
+        FakeSide gpu, cpu;
+        gpu.nanosecondsPerPixel = 600.0;
+        cpu.nanosecondsPerPixel = 200.0;
+        HybridBlurScheduler scheduler(gpu.bandRenderer(), cpu.bandRenderer(), virtualClock);
+
+        const int width = 128, height = 128;
+        std::vector<unsigned char> pixels = randomImage(width, height, 7);
+        for (int i = 0; i < 12; ++i) {
+            scheduler.render(pixels.data(), width, height, 4.0f, pixels.data());
+        }
+        std::printf("GPU 3x slower: share %.2f, GPU %.1f MP/s, CPU %.1f MP/s\n", scheduler.gpuShare(),
+                    scheduler.gpuThroughput() / 1e6, scheduler.cpuThroughput() / 1e6);
+        expect(scheduler.gpuShare() > 0.15f && scheduler.gpuShare() < 0.35f,
+               "a 3x slower GPU gets about a quarter of the rows");
+    }
+
+    void checkGpuBandKeepsItsHeight() {
+        FakeSide gpu, cpu;
+        HybridBlurScheduler scheduler(gpu.bandRenderer(), cpu.bandRenderer(), virtualClock);
+
+        // The CPU side's speed wavers a little from blur to blur, like measured speeds do
+        const int width = 64, height = 600;
+        const float radius = 3.0f;
+        std::vector<unsigned char> pixels = randomImage(width, height, 13);
+        for (int i = 0; i < 12; ++i) {
+            gpu.nanosecondsPerPixel = 100.0;
+            cpu.nanosecondsPerPixel = i % 2 ? 104.0 : 96.0;
+            scheduler.render(pixels.data(), width, height, radius, pixels.data());
+        }
+
+        int halo = HybridBlurScheduler::calculateHalo(radius);
+        bool snapped = true;
+        for (int bandHeight : gpu.heights) {
+            snapped &= (bandHeight - halo) % HybridBlurScheduler::kBandRowStep == 0;
+        }
+        expect(snapped, "the GPU band is a whole number of row steps plus its halo");
+        bool steady = std::equal(gpu.heights.begin() + 1, gpu.heights.end(), gpu.heights.begin());
+        expect(gpu.heights.size() > 2 && steady,
+               "the GPU band keeps its height while the share wavers");
+    }
+
+    void checkSlowSideIsLeftOut() {
+        FakeSide gpu, cpu;
+        gpu.nanosecondsPerPixel = 2000.0;
+        cpu.nanosecondsPerPixel = 50.0;
+        HybridBlurScheduler scheduler(gpu.bandRenderer(), cpu.bandRenderer(), virtualClock);
+
+        const int width = 64, height = 64;
+        std::vector<unsigned char> pixels = randomImage(width, height, 9);
+        scheduler.render(pixels.data(), width, height, 2.0f, pixels.data());
+        expect(scheduler.gpuShare() < HybridBlurScheduler::kMinShare, "a very slow GPU drops below the minimum share");
+
+        int gpuCalls = gpu.calls;
+        for (int i = 0; i < HybridBlurScheduler::kProbeInterval - 1; ++i) {
+            scheduler.render(pixels.data(), width, height, 2.0f, pixels.data());
+        }
+        expect(gpu.calls == gpuCalls, "a left out GPU gets no work between probes");
+        scheduler.render(pixels.data(), width, height, 2.0f, pixels.data());
+        expect(gpu.calls == gpuCalls + 1, "a left out GPU is probed after kProbeInterval blurs");
+    }
+
+    void checkGpuFailureFallsBackToCpu() {
+        FakeSide gpu, cpu;
+        gpu.failing = true;
+        HybridBlurScheduler scheduler(gpu.bandRenderer(), cpu.bandRenderer(), virtualClock);
+        CpuBlurRenderer reference(2);
+
+        const int width = 90, height = 120;
+        std::vector<unsigned char> input = randomImage(width, height, 11);
+        std::vector<unsigned char> expected(input.size());
+        reference.render(input.data(), width, height, 5.0f, expected.data());
+
+        std::vector<unsigned char> pixels = input;
+        scheduler.render(pixels.data(), width, height, 5.0f, pixels.data());
+        expect(pixels == expected, "a failing GPU band is blurred again on the CPU");
+        expect(scheduler.gpuFailed(), "a failing GPU is marked as failed");
+
+        int gpuCalls = gpu.calls;
+        for (int i = 0; i < HybridBlurScheduler::kProbeInterval * 2; ++i) {
+            scheduler.render(pixels.data(), width, height, 5.0f, pixels.data());
+        }
+        expect(gpu.calls == gpuCalls, "a failed GPU is never used again");
+    }
+}
+
+int main() {
+    checkSplitMatchesWholeImage();
+    checkShareFollowsThroughput();
+    checkGpuBandKeepsItsHeight();
+    checkSlowSideIsLeftOut();
+    checkGpuFailureFallsBackToCpu();
+
+    return finishTest("hybrid_blur_test");
+}
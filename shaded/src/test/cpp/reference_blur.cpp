@@ -0,0 +1,69 @@
+#include "reference_blur.h"
+#include <algorithm>
+#include <cmath>
+
+std::vector<double> referenceKernel(double radius, int& kernelRadius) {
+    kernelRadius = radius <= 0.5 ? 0 : static_cast<int>(std::ceil(radius));
+    std::vector<double> weights(2 * kernelRadius + 1, 0.0);
+    if (kernelRadius == 0) {
+        weights[0] = 1.0;
+        return weights;
+    }
+
+    double sigma = radius / 2.0;
+    double total = 0.0;
+    for (int x = -kernelRadius; x <= kernelRadius; ++x) {
+        if (std::abs(x) <= radius) {
+            weights[x + kernelRadius] = std::exp(-(x * x) / (2.0 * sigma * sigma));
+            total += weights[x + kernelRadius];
+        }
+    }
+    for (double& weight : weights) weight /= total;
+    return weights;
+}
+
+std::vector<double> referenceBlur(const unsigned char* input, int width, int height, double radius,
+                                  BlurEdgeMode edgeMode, int padding) {
+    bool clampEdges = edgeMode == BlurEdgeMode::Rectangle;
+    if (clampEdges) padding = 0;
+    int outputWidth = width + 2 * padding;
+    int outputHeight = height + 2 * padding;
+
+    int kernelRadius;
+    std::vector<double> weights = referenceKernel(radius, kernelRadius);
+
+    // Returns false for samples that are transparent
+    auto sourceIndex = [&](int& index, int size) {
+        if (index >= 0 && index < size) return true;
+        if (!clampEdges) return false;
+        index = std::min(std::max(index, 0), size - 1);
+        return true;
+    };
+
+    // Horizontal pass over input rows only, rows outside are transparent either way
+    std::vector<double> intermediate(static_cast<size_t>(outputWidth) * height * 4, 0.0);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < outputWidth; ++x) {
+            double* target = &intermediate[(static_cast<size_t>(y) * outputWidth + x) * 4];
+            for (int k = -kernelRadius; k <= kernelRadius; ++k) {
+                int sourceX = x - padding + k;
+                if (!sourceIndex(sourceX, width)) continue;
+                const unsigned char* source = input + (static_cast<size_t>(y) * width + sourceX) * 4;
+                for (int c = 0; c < 4; ++c) target[c] += source[c] * weights[k + kernelRadius];
+            }
+        }
+    }
+
+    std::vector<double> output(static_cast<size_t>(outputWidth) * outputHeight * 4, 0.0);
+    for (int y = 0; y < outputHeight; ++y) {
+        for (int k = -kernelRadius; k <= kernelRadius; ++k) {
+            int sourceY = y - padding + k;
+            if (!sourceIndex(sourceY, height)) continue;
+            double weight = weights[k + kernelRadius];
+            const double* source = &intermediate[static_cast<size_t>(sourceY) * outputWidth * 4];
+            double* target = &output[static_cast<size_t>(y) * outputWidth * 4];
+            for (int i = 0; i < outputWidth * 4; ++i) target[i] += source[i] * weight;
+        }
+    }
+    return output;
+}
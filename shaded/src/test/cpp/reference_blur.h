@@ -0,0 +1,20 @@
+#ifndef REFERENCE_BLUR_H
+#define REFERENCE_BLUR_H
+
+#include <vector>
+#include "blur_edge_mode.h"
+
+// Double precision reference of the blur every backend implements: a normalized Gaussian with
+// sigma = radius / 2 and taps up to |x| <= radius, applied separably without any rounding.
+// Rectangle clamps samples to the edge, unbounded reads transparent pixels outside the input
+// and grows the output by padding on every side.
+//
+// Input is tightly packed RGBA8888, the result holds (width + 2 * padding) x
+// (height + 2 * padding) RGBA values in 0 ... 255.
+std::vector<double> referenceBlur(const unsigned char* input, int width, int height, double radius,
+                                  BlurEdgeMode edgeMode, int padding);
+
+// Normalized weights for offsets -kernelRadius ... kernelRadius
+std::vector<double> referenceKernel(double radius, int& kernelRadius);
+
+#endif // REFERENCE_BLUR_H
@@ -0,0 +1,188 @@
+#include "blur_renderer.h"
+#include "gl_call_recorder.h"
+#include "test_support.h"
+#include "unbounded_blur.h"
+#include <cstdio>
+#include <vector>
+
+// Per-blur GL call budgets. Every blur after the first one at a given size should only set
+// uniforms, bind what it draws with and draw: no location lookups, no attribute setup and no
+// framebuffer reallocation. Lower a budget when an optimization lands, never raise it silently.
+
+namespace {
+    void expectAtMost(const char* scenario, const char* what, int actual, int budget) {
+        if (actual > budget) {
+            std::fprintf(stderr, "FAIL %s: %s = %d, budget %d\n", scenario, what, actual, budget);
+            ++failures;
+        }
+    }
+
+    void expectCall(const char* scenario, const char* function, int budget) {
+        expectAtMost(scenario, function, GLCallRecorder::instance().count(function), budget);
+    }
+
+    void printCounts(const char* scenario) {
+        const GLCallRecorder& recorder = GLCallRecorder::instance();
+        std::printf("%s: %d calls, %d state changes, %d texture allocations\n",
+                    scenario, recorder.total(), recorder.stateChanges(), recorder.textureAllocations());
+        for (const auto& entry : recorder.counts()) {
+            std::printf("    %-28s %d\n", entry.first.c_str(), entry.second);
+        }
+    }
+
+    void blurRectangle(BlurRenderer& renderer, std::vector<unsigned char>& pixels,
+                       int width, int height, float radius) {
+        GLuint texture = renderer.uploadBitmapAsTexture(pixels.data(), width, height,
+                                                        PixelFormat::Rgba8888, width * 4);
+        renderer.render(texture, width, height, radius, 1);
+        renderer.readFBO(pixels.data(), width, height, PixelFormat::Rgba8888, width * 4);
+        glDeleteTextures(1, &texture);
+    }
+
+    void blurScrolled(BlurRenderer& renderer, std::vector<unsigned char>& pixels, int width, int height,
+                      float radius, int scrollX, int scrollY) {
+        GLuint texture = renderer.uploadBitmapAsTexture(pixels.data(), width, height,
+                                                        PixelFormat::Rgba8888, width * 4);
+        renderer.renderScrolled(texture, width, height, radius, 1, scrollX, scrollY);
+        renderer.readFBO(pixels.data(), width, height, PixelFormat::Rgba8888, width * 4);
+        glDeleteTextures(1, &texture);
+    }
+
+    void blurUnbounded(UnboundedBlurRenderer& renderer, const std::vector<unsigned char>& pixels,
+                       int width, int height, float radius, std::vector<unsigned char>& output) {
+        GLuint texture = renderer.uploadBitmapAsTexture(pixels.data(), width, height,
+                                                        PixelFormat::Rgba8888, width * 4);
+        int outputWidth, outputHeight;
+        renderer.render(texture, width, height, radius, 1, outputWidth, outputHeight);
+        output.resize(static_cast<size_t>(outputWidth) * outputHeight * 4);
+        renderer.readFBO(output.data(), outputWidth, outputHeight, PixelFormat::Rgba8888, outputWidth * 4);
+        glDeleteTextures(1, &texture);
+    }
+
+    void checkSteadyStateBlur(const char* scenario, int drawCalls, int uniformCalls, int stateChanges) {
+        expectCall(scenario, "glGetUniformLocation", 0);
+        expectCall(scenario, "glGetAttribLocation", 0);
+        expectCall(scenario, "glVertexAttribPointer", 0);
+        expectCall(scenario, "glEnableVertexAttribArray", 0);
+        expectCall(scenario, "glCreateProgram", 0);
+        expectCall(scenario, "eglMakeCurrent", 0);
+        expectCall(scenario, "glFramebufferTexture2D", 0);
+        expectCall(scenario, "glTexImage2D", 1); // The upload
+        expectAtMost(scenario, "texture allocations", GLCallRecorder::instance().textureAllocations(), 0);
+        expectCall(scenario, "glDrawArrays", drawCalls);
+        expectCall(scenario, "glBindFramebuffer", drawCalls + 1); // Passes and the readback
+        expectCall(scenario, "glUseProgram", drawCalls);
+
+        const GLCallRecorder& recorder = GLCallRecorder::instance();
+        int uniforms = recorder.count("glUniform1f") + recorder.count("glUniform1i") +
+                       recorder.count("glUniform2f") + recorder.count("glUniform3f") +
+                       recorder.count("glUniform4f");
+        expectAtMost(scenario, "uniform updates", uniforms, uniformCalls);
+        expectAtMost(scenario, "state changes", recorder.stateChanges(), stateChanges);
+        expectAtMost(scenario, "non-finite uniforms", recorder.nonFiniteUniforms(), 0);
+    }
+}
+
+int main() {
+    const int width = 64;
+    const int height = 48;
+    std::vector<unsigned char> pixels(width * height * 4, 128);
+    std::vector<unsigned char> output;
+    GLCallRecorder& recorder = GLCallRecorder::instance();
+
+    {
+        BlurRenderer renderer(16, 16);
+
+        // The first blur compiles shaders and allocates framebuffers, later ones reuse them
+        blurRectangle(renderer, pixels, width, height, 10.0f);
+        recorder.reset();
+        blurRectangle(renderer, pixels, width, height, 10.0f);
+        printCounts("rectangle two-pass");
+        checkSteadyStateBlur("rectangle two-pass", 2, 4, 12);
+
+        recorder.reset();
+        blurRectangle(renderer, pixels, width, height, 1.5f);
+        printCounts("rectangle single pass");
+        checkSteadyStateBlur("rectangle single pass", 1, 2, 8);
+
+        // Below radius 1 only the center tap has weight, the single pass still draws once
+        recorder.reset();
+        blurRectangle(renderer, pixels, width, height, 0.75f);
+        printCounts("rectangle radius 0.75");
+        checkSteadyStateBlur("rectangle radius 0.75", 1, 2, 8);
+    }
+
+    {
+        // A scrolled frame copies the previous output over and blurs the four strips around it:
+        // one draw for the copy, and one per strip for small radii or two for larger ones
+        BlurRenderer renderer(16, 16);
+        blurScrolled(renderer, pixels, width, height, 10.0f, 0, 0);
+        blurScrolled(renderer, pixels, width, height, 10.0f, 0, 3);
+        recorder.reset();
+        blurScrolled(renderer, pixels, width, height, 10.0f, 2, 3);
+        printCounts("rectangle scrolled two-pass");
+        checkSteadyStateBlur("rectangle scrolled two-pass", 9, 17, 50);
+        expectCall("rectangle scrolled two-pass", "glScissor", 8);
+
+        blurScrolled(renderer, pixels, width, height, 1.5f, 0, 0);
+        recorder.reset();
+        blurScrolled(renderer, pixels, width, height, 1.5f, 0, 3);
+        printCounts("rectangle scrolled single pass");
+        checkSteadyStateBlur("rectangle scrolled single pass", 5, 9, 30);
+        expectCall("rectangle scrolled single pass", "glScissor", 4);
+    }
+
+    {
+        // A renderer that only ever blurs small radii never allocates the intermediate texture
+        recorder.reset();
+        BlurRenderer renderer(16, 16);
+        blurRectangle(renderer, pixels, width, height, 1.5f);
+        blurRectangle(renderer, pixels, width, height, 0.25f);
+        expectAtMost("rectangle small radii", "texture allocations", recorder.textureAllocations(), 2);
+    }
+
+    {
+        // Rendering into a shared image's framebuffer leaves out the readback, and reuses the
+        // renderer's framebuffers like any other blur
+        BlurRenderer renderer(16, 16);
+        blurRectangle(renderer, pixels, width, height, 10.0f);
+        recorder.reset();
+        GLuint texture = renderer.uploadBitmapAsTexture(pixels.data(), width, height, PixelFormat::Rgba8888, width * 4);
+        renderer.renderInto(texture, width, height, 10.0f, 1, 1000);
+        glDeleteTextures(1, &texture);
+        expectCall("rectangle into shared image", "glReadPixels", 0);
+        expectCall("rectangle into shared image", "glBindFramebuffer", 2);
+        expectCall("rectangle into shared image", "glFramebufferTexture2D", 0);
+    }
+
+    {
+        UnboundedBlurRenderer renderer(16, 16);
+
+        blurUnbounded(renderer, pixels, width, height, 10.0f, output);
+        recorder.reset();
+        blurUnbounded(renderer, pixels, width, height, 10.0f, output);
+        printCounts("unbounded two-pass");
+        checkSteadyStateBlur("unbounded two-pass", 2, 6, 12);
+
+        blurUnbounded(renderer, pixels, width, height, 1.5f, output);
+        recorder.reset();
+        blurUnbounded(renderer, pixels, width, height, 1.5f, output);
+        printCounts("unbounded single pass");
+        checkSteadyStateBlur("unbounded single pass", 1, 4, 8);
+    }
+
+    {
+        // Both renderers share the render thread, each switch between them is one eglMakeCurrent
+        BlurRenderer rectangle(16, 16);
+        UnboundedBlurRenderer unbounded(16, 16);
+        blurRectangle(rectangle, pixels, width, height, 10.0f);
+        blurUnbounded(unbounded, pixels, width, height, 10.0f, output);
+
+        recorder.reset();
+        blurRectangle(rectangle, pixels, width, height, 10.0f);
+        blurUnbounded(unbounded, pixels, width, height, 10.0f, output);
+        expectCall("alternating renderers", "eglMakeCurrent", 2);
+    }
+
+    return finishTest("renderer_gl_calls_test");
+}
@@ -0,0 +1,120 @@
+#include "blur_renderer.h"
+#include "test_support.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+// Scrolls a window over tall content and checks that every frame BlurRenderer::renderScrolled
+// builds out of the previous one matches a full blur of the same frame. Renders through the
+// host's real EGL / GLES2, and is skipped when there is none.
+
+namespace {
+    // Largest channel difference to a full blur, in 8 bit levels
+    const int kMaxError = 2;
+
+    struct Content {
+        int width;
+        int height;
+        std::vector<unsigned char> pixels;
+    };
+
+    Content makeContent(int width, int height) {
+        Content content{width, height, std::vector<unsigned char>(static_cast<size_t>(width) * height * 4)};
+        std::mt19937 random(42);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                unsigned char* pixel = &content.pixels[(static_cast<size_t>(y) * width + x) * 4];
+                // Noise over stripes, so both fine detail and large shapes move with the scroll
+                unsigned char stripe = (y / 9) % 2 == 0 ? 200 : 40;
+                pixel[0] = static_cast<unsigned char>(random() & 0xff);
+                pixel[1] = stripe;
+                pixel[2] = static_cast<unsigned char>((x * 255) / width);
+                pixel[3] = 255;
+            }
+        }
+        return content;
+    }
+
+    // The width x height window of content whose top left corner is at (left, top)
+    std::vector<unsigned char> frameAt(const Content& content, int left, int top, int width, int height) {
+        std::vector<unsigned char> frame(static_cast<size_t>(width) * height * 4);
+        for (int y = 0; y < height; ++y) {
+            const unsigned char* row = &content.pixels[(static_cast<size_t>(top + y) * content.width + left) * 4];
+            std::copy(row, row + width * 4, frame.begin() + static_cast<size_t>(y) * width * 4);
+        }
+        return frame;
+    }
+
+    std::vector<unsigned char> blur(BlurRenderer& renderer, const std::vector<unsigned char>& frame,
+                                    int width, int height, float radius, bool scrolled,
+                                    long long frameKey, int scrollX, int scrollY) {
+        GLuint texture = renderer.uploadBitmapAsTexture(frame.data(), width, height, PixelFormat::Rgba8888, width * 4);
+        if (scrolled) {
+            renderer.renderScrolled(texture, width, height, radius, frameKey, scrollX, scrollY);
+        } else {
+            renderer.render(texture, width, height, radius, 1);
+        }
+        std::vector<unsigned char> result(frame.size());
+        renderer.readFBO(result.data(), width, height, PixelFormat::Rgba8888, width * 4);
+        glDeleteTextures(1, &texture);
+        return result;
+    }
+
+    int maxError(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+        int error = 0;
+        for (size_t i = 0; i < a.size(); ++i) error = std::max(error, std::abs(a[i] - b[i]));
+        return error;
+    }
+
+    void checkScrollMatchesFullBlur(BlurRenderer& scrolling, BlurRenderer& full, float radius) {
+        const int width = 90, height = 70;
+        Content content = makeContent(140, 300);
+
+        // Window positions of consecutive frames: down, down and right, back up, and a jump
+        // further than the window is tall, which has nothing left to reuse
+        const int path[][2] = {{10, 20}, {10, 23}, {14, 31}, {11, 26}, {11, 26}, {11, 140}, {12, 141}};
+        long long frameKey = static_cast<long long>(radius * 100);
+        int previousLeft = path[0][0], previousTop = path[0][1];
+
+        for (const auto& position : path) {
+            int left = position[0], top = position[1];
+            std::vector<unsigned char> frame = frameAt(content, left, top, width, height);
+
+            std::vector<unsigned char> scrolled = blur(scrolling, frame, width, height, radius, true, frameKey,
+                                                       left - previousLeft, top - previousTop);
+            std::vector<unsigned char> expected = blur(full, frame, width, height, radius, false, 0, 0, 0);
+
+            // Reused pixels were blurred where they were in an earlier frame, and the GL blur of the
+            // same content rounds its sample positions a little differently elsewhere in the texture
+            int error = maxError(scrolled, expected);
+            if (error > kMaxError) {
+                std::fprintf(stderr, "radius %.2f, frame at (%d, %d): max error %d\n", radius, left, top, error);
+            }
+            expect(error <= kMaxError, "a scrolled blur matches a full blur of the same frame");
+
+            previousLeft = left;
+            previousTop = top;
+        }
+    }
+}
+
+int main() {
+    try {
+        BlurRenderer scrolling(16, 16);
+        scrolling.initialize();
+        BlurRenderer full(16, 16);
+        full.initialize();
+
+        for (float radius : {0.3f, 1.5f, 2.0f, 6.0f, 17.0f}) {
+            checkScrollMatchesFullBlur(scrolling, full, radius);
+        }
+    } catch (const std::runtime_error& e) {
+        std::printf("scrolled_blur_test skipped: %s\n", e.what());
+        return kSkipped;
+    }
+
+    return finishTest("scrolled_blur_test");
+}
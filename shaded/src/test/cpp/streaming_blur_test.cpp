@@ -0,0 +1,145 @@
+#include "cpu_blur.h"
+#include "streaming_blur.h"
+#include "test_support.h"
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Checks StreamingBlurRenderer against the CPU renderer it shares its kernel with, that it
+// emits rows while input is still coming in, and that its buffers don't grow with the height.
+
+namespace {
+    std::vector<unsigned char> streamBlur(StreamingBlurRenderer& renderer, const std::vector<unsigned char>& input,
+                                          int width, int height, float radius, BlurEdgeMode edgeMode) {
+        int padding = StreamingBlurRenderer::calculatePadding(radius, edgeMode);
+        size_t inputRowBytes = static_cast<size_t>(width) * 4;
+        size_t outputRowBytes = static_cast<size_t>(width + 2 * padding) * 4;
+        std::vector<unsigned char> output(outputRowBytes * (height + 2 * padding));
+
+        int nextRow = 0;
+        renderer.render(width, height, radius, edgeMode,
+                        [&](int y, unsigned char* scratch) -> const unsigned char* {
+                            std::copy(input.begin() + y * inputRowBytes, input.begin() + (y + 1) * inputRowBytes,
+                                      scratch);
+                            return scratch;
+                        },
+                        [&](int y, const unsigned char* row) {
+                            if (y != nextRow++) throw std::runtime_error("rows out of order");
+                            std::copy(row, row + outputRowBytes, output.begin() + y * outputRowBytes);
+                        });
+        return output;
+    }
+
+    void checkMatchesCpuRenderer() {
+        CpuBlurRenderer cpu(2);
+        StreamingBlurRenderer streaming(2);
+
+        const int sizes[][2] = {{131, 203}, {57, 7}, {1, 40}};
+        for (const auto& size : sizes) {
+            int width = size[0], height = size[1];
+            for (float radius : {0.3f, 1.0f, 3.5f, 12.0f, 40.0f}) {
+                std::vector<unsigned char> input = randomImage(width, height, static_cast<unsigned>(radius * 10));
+
+                std::vector<unsigned char> expected(input.size());
+                cpu.render(input.data(), width, height, radius, expected.data());
+                expect(streamBlur(streaming, input, width, height, radius, BlurEdgeMode::Rectangle) == expected,
+                       "rectangle blur matches the CPU renderer");
+
+                int padding = CpuBlurRenderer::calculatePadding(radius);
+                expected.assign(static_cast<size_t>(width + 2 * padding) * (height + 2 * padding) * 4, 0);
+                int outputWidth, outputHeight;
+                cpu.renderUnbounded(input.data(), width, height, radius, expected.data(), outputWidth, outputHeight);
+                expect(streamBlur(streaming, input, width, height, radius, BlurEdgeMode::Unbounded) == expected,
+                       "unbounded blur matches the CPU renderer");
+            }
+        }
+    }
+
+    void checkRowsLeaveBeforeInputEnds() {
+        StreamingBlurRenderer streaming(2);
+        const int width = 64, height = 1000;
+        const float radius = 10.0f;
+        std::vector<unsigned char> row(width * 4, 200);
+
+        int requested = 0;
+        bool streamed = true;
+        streaming.render(width, height, radius, BlurEdgeMode::Rectangle,
+                         [&](int y, unsigned char*) -> const unsigned char* {
+                             requested = y + 1;
+                             return row.data();
+                         },
+                         [&](int y, const unsigned char*) {
+                             // The rows of the band and the kernel reach below it, nothing more
+                             if (requested > y + 10 + 2 * StreamingBlurRenderer::kBandHeight) streamed = false;
+                         });
+        expect(streamed, "output rows are emitted while input rows are still coming in");
+        expect(requested == height, "every input row is read");
+    }
+
+    void checkMemoryIndependentOfHeight() {
+        StreamingBlurRenderer streaming(1);
+        std::vector<unsigned char> row(300 * 4, 50);
+        auto source = [&](int, unsigned char*) -> const unsigned char* { return row.data(); };
+        auto sink = [](int, const unsigned char*) {};
+
+        streaming.render(300, 100, 20.0f, BlurEdgeMode::Unbounded, source, sink);
+        size_t shortImage = streaming.bufferBytes();
+        streaming.render(300, 20000, 20.0f, BlurEdgeMode::Unbounded, source, sink);
+        expect(streaming.bufferBytes() == shortImage, "buffers don't grow with the image height");
+        expect(shortImage < static_cast<size_t>(340) * 4 * (2 * 20 + 3 * StreamingBlurRenderer::kBandHeight),
+               "buffers hold a ring of rows, not the image");
+    }
+
+    std::string temporaryPath() {
+        char path[] = "/tmp/streaming_blur_testXXXXXX";
+        int fd = mkstemp(path);
+        if (fd >= 0) close(fd);
+        return path;
+    }
+
+    void checkRawFiles() {
+        StreamingBlurRenderer streaming(2);
+        const int width = 77, height = 150;
+        const float radius = 6.0f;
+        std::vector<unsigned char> input = randomImage(width, height, 7);
+
+        std::string inputPath = temporaryPath();
+        std::string outputPath = temporaryPath();
+        FILE* file = std::fopen(inputPath.c_str(), "wb");
+        std::fwrite(input.data(), 1, input.size(), file);
+        std::fclose(file);
+
+        streaming.renderFile(inputPath, width, height, radius, BlurEdgeMode::Unbounded, outputPath);
+        std::vector<unsigned char> expected = streamBlur(streaming, input, width, height, radius, BlurEdgeMode::Unbounded);
+
+        std::vector<unsigned char> actual(expected.size() + 1);
+        file = std::fopen(outputPath.c_str(), "rb");
+        size_t read = std::fread(actual.data(), 1, actual.size(), file);
+        std::fclose(file);
+        actual.resize(read);
+        expect(actual == expected, "raw file output matches the row callback output");
+
+        bool threw = false;
+        try {
+            streaming.renderFile(inputPath, width, height + 1, radius, BlurEdgeMode::Unbounded, outputPath);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        expect(threw, "input files of the wrong size are rejected");
+
+        std::remove(inputPath.c_str());
+        std::remove(outputPath.c_str());
+    }
+}
+
+int main() {
+    checkMatchesCpuRenderer();
+    checkRowsLeaveBeforeInputEnds();
+    checkMemoryIndependentOfHeight();
+    checkRawFiles();
+
+    return finishTest("streaming_blur_test");
+}
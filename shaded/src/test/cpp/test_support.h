@@ -0,0 +1,56 @@
+#ifndef TEST_SUPPORT_H
+#define TEST_SUPPORT_H
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Shared by the host tests, each of which is a single source file built into its own executable.
+// Checks report through expect, or print their own FAIL line and bump failures, and main ends
+// with finishTest.
+
+// Exit code ctest reports as skipped, for tests that need something the host doesn't have
+constexpr int kSkipped = 77;
+
+inline int failures = 0;
+
+inline void expect(bool condition, const char* what) {
+    if (!condition) {
+        std::fprintf(stderr, "FAIL %s\n", what);
+        ++failures;
+    }
+}
+
+// Exit code of the test named name, after reporting how it went
+inline int finishTest(const char* name) {
+    if (failures > 0) {
+        std::fprintf(stderr, "%d failure(s)\n", failures);
+        return 1;
+    }
+    std::printf("%s passed\n", name);
+    return 0;
+}
+
+// Tightly packed RGBA8888 pixels of random bytes
+inline std::vector<unsigned char> randomImage(int width, int height, unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+    for (unsigned char& value : pixels) value = static_cast<unsigned char>(random() & 0xff);
+    return pixels;
+}
+
+// Like randomImage, but premultiplied like bitmap pixels: no channel is above alpha
+inline std::vector<unsigned char> randomPremultipliedImage(int width, int height, unsigned seed) {
+    std::mt19937 random(seed);
+    std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 4);
+    for (size_t i = 0; i < pixels.size(); i += 4) {
+        unsigned char alpha = static_cast<unsigned char>(random() & 0xff);
+        for (int c = 0; c < 3; ++c) {
+            pixels[i + c] = static_cast<unsigned char>(random() % (alpha + 1));
+        }
+        pixels[i + 3] = alpha;
+    }
+    return pixels;
+}
+
+#endif // TEST_SUPPORT_H
@@ -0,0 +1,115 @@
+#include "cpu_blur.h"
+#include "vulkan_blur.h"
+#include "test_support.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Compares the Vulkan compute blur against the CPU blur and reports throughput of both.
+// Runs on whatever Vulkan implementation the loader finds, lavapipe on a host without a GPU.
+// Exits with 77 (skipped) when there is none.
+
+namespace {
+    // Both accumulate in float, but round differently on the way back to bytes
+    constexpr int kMaxChannelError = 2;
+
+    void compare(const char* scenario, const std::vector<unsigned char>& expected,
+                 const std::vector<unsigned char>& actual) {
+        int maxError = 0;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            maxError = std::max(maxError, std::abs(expected[i] - actual[i]));
+        }
+        if (maxError > kMaxChannelError) {
+            std::fprintf(stderr, "FAIL %s: max channel error %d\n", scenario, maxError);
+            ++failures;
+        }
+    }
+
+    void checkBlur(VulkanBlurRenderer& vulkan, CpuBlurRenderer& cpu, int width, int height,
+                   float radius, BlurEdgeMode edgeMode) {
+        char scenario[96];
+        std::snprintf(scenario, sizeof(scenario), "%dx%d radius %.1f %s", width, height, radius,
+                      edgeMode == BlurEdgeMode::Rectangle ? "rectangle" : "unbounded");
+
+        std::vector<unsigned char> input = randomPremultipliedImage(width, height, static_cast<unsigned>(width * height));
+        int padding = edgeMode == BlurEdgeMode::Rectangle ? 0 : CpuBlurRenderer::calculatePadding(radius);
+        size_t outputBytes = static_cast<size_t>(width + 2 * padding) * (height + 2 * padding) * 4;
+
+        std::vector<unsigned char> expected(outputBytes);
+        int cpuWidth = width, cpuHeight = height;
+        if (edgeMode == BlurEdgeMode::Rectangle) {
+            cpu.render(input.data(), width, height, radius, expected.data());
+        } else {
+            cpu.renderUnbounded(input.data(), width, height, radius, expected.data(), cpuWidth, cpuHeight);
+        }
+
+        std::vector<unsigned char> actual(outputBytes);
+        int vulkanWidth, vulkanHeight;
+        vulkan.render(input.data(), width, height, radius, edgeMode, actual.data(), vulkanWidth, vulkanHeight);
+
+        if (vulkanWidth != cpuWidth || vulkanHeight != cpuHeight) {
+            std::fprintf(stderr, "FAIL %s: output %dx%d, expected %dx%d\n", scenario,
+                         vulkanWidth, vulkanHeight, cpuWidth, cpuHeight);
+            ++failures;
+            return;
+        }
+        compare(scenario, expected, actual);
+    }
+
+    double millisecondsPerMegapixel(int width, int height, int iterations, const std::function<void()>& blur) {
+        blur();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) blur();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / iterations / (width * height / 1e6);
+    }
+
+    void benchmark(VulkanBlurRenderer& vulkan, CpuBlurRenderer& cpu) {
+        const int width = 1024, height = 1024, iterations = 5;
+        std::vector<unsigned char> input = randomPremultipliedImage(width, height, 3);
+        std::vector<unsigned char> output(input.size());
+
+        for (float radius : {4.0f, 16.0f, 64.0f}) {
+            int outputWidth, outputHeight;
+            double vulkanTime = millisecondsPerMegapixel(width, height, iterations, [&] {
+                vulkan.render(input.data(), width, height, radius, BlurEdgeMode::Rectangle, output.data(),
+                              outputWidth, outputHeight);
+            });
+            double cpuTime = millisecondsPerMegapixel(width, height, iterations, [&] {
+                cpu.render(input.data(), width, height, radius, output.data());
+            });
+            std::printf("radius %5.1f: vulkan %7.2f ms/MP, cpu (%d threads) %7.2f ms/MP\n",
+                        radius, vulkanTime, cpu.threadCount(), cpuTime);
+        }
+    }
+}
+
+int main() {
+    std::unique_ptr<VulkanBlurRenderer> vulkan;
+    try {
+        vulkan = std::make_unique<VulkanBlurRenderer>();
+    } catch (const std::runtime_error& e) {
+        std::printf("SKIP no Vulkan: %s\n", e.what());
+        return kSkipped;
+    }
+    std::printf("Vulkan device: %s\n", vulkan->deviceName());
+
+    CpuBlurRenderer cpu(static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+
+    for (BlurEdgeMode edgeMode : {BlurEdgeMode::Rectangle, BlurEdgeMode::Unbounded}) {
+        // Copy, small and large kernels, and a radius past the shared memory halo
+        for (float radius : {0.3f, 1.0f, 2.5f, 8.0f, 25.0f, 150.0f}) {
+            checkBlur(*vulkan, cpu, 97, 61, radius, edgeMode);
+        }
+        checkBlur(*vulkan, cpu, 300, 513, 12.0f, edgeMode);
+    }
+    benchmark(*vulkan, cpu);
+
+    return finishTest("vulkan_blur_test");
+}